@@ -0,0 +1,442 @@
+/*
+  ==============================================================================
+
+    TelayBench.cpp
+
+    Headless benchmark for TelayAudioProcessor. Runs every effect type over
+    a grid of sample rates and block sizes and reports the cost per sample,
+    heap allocations on the audio path and, where perf is available, cache
+    misses per block.
+
+    Exits with a non-zero status if any configuration allocated on the audio
+    thread or produced non-finite output, so it doubles as a regression check.
+
+    --check-determinism renders a fixed input with MIDI CC automation offline
+    through every effect type at block sizes from 1 to 8192 instead, and fails
+    unless every render is bit for bit the same. --golden=<file> also compares
+    a hash of each type's render with the ones in the file, and fails if the
+    file is missing. --update-golden writes the file instead. Golden files are
+    only comparable between builds with the same compiler, flags and platform.
+    CTest runs this against Bench/golden.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include "../Source/PluginProcessor.h"
+#include "../Source/AllocationGuard.h"
+
+#if JUCE_LINUX
+ #include <linux/perf_event.h>
+ #include <sys/ioctl.h>
+ #include <sys/syscall.h>
+ #include <unistd.h>
+#endif
+
+//==============================================================================
+// Hardware cache miss counter for the calling thread, silently unavailable
+// when perf_event_open isn't permitted (containers, perf_event_paranoid)
+class CacheMissCounter
+{
+public:
+    CacheMissCounter()
+    {
+#if JUCE_LINUX
+        perf_event_attr attr {};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        mFd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+    }
+
+    ~CacheMissCounter()
+    {
+#if JUCE_LINUX
+        if (mFd >= 0) {
+            close(mFd);
+        }
+#endif
+    }
+
+    bool isAvailable() const { return mFd >= 0; }
+
+    void start()
+    {
+#if JUCE_LINUX
+        if (mFd >= 0) {
+            ioctl(mFd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(mFd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    juce::int64 stop()
+    {
+        juce::int64 count = 0;
+#if JUCE_LINUX
+        if (mFd >= 0) {
+            ioctl(mFd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(mFd, &count, sizeof(count)) != sizeof(count)) {
+                count = 0;
+            }
+        }
+#endif
+        return count;
+    }
+
+private:
+    int mFd = -1;
+};
+
+//==============================================================================
+struct BenchResult
+{
+    double nsPerSample;
+    double allocationsPerBlock;
+    double cacheMissesPerBlock;
+    bool finite;
+};
+
+static void setParameter(juce::AudioProcessor& processor, const juce::String& id, float value)
+{
+    for (auto* parameter : processor.getParameters()) {
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameter)) {
+            if (ranged->getParameterID() == id) {
+                ranged->setValueNotifyingHost(ranged->convertTo0to1(value));
+                return;
+            }
+        }
+    }
+    jassertfalse; // unknown parameter id
+}
+
+static BenchResult runConfiguration(double sampleRate, int blockSize, int type, int oversampling, double seconds,
+    CacheMissCounter& cacheMisses)
+{
+    TelayAudioProcessor processor;
+    setParameter(processor, "Type", (float)type);
+    setParameter(processor, "Oversampling", (float)oversampling);
+
+    processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+    processor.prepareToPlay(sampleRate, blockSize);
+
+    // a second of noise to loop through as input
+    juce::AudioBuffer<float> noise(2, (int)sampleRate);
+    juce::Random random(0x7e1a);
+    for (int channel = 0; channel < noise.getNumChannels(); channel++) {
+        for (int i = 0; i < noise.getNumSamples(); i++) {
+            noise.setSample(channel, i, (random.nextFloat() * 2 - 1) * 0.25f);
+        }
+    }
+
+    juce::AudioBuffer<float> buffer(2, blockSize);
+    juce::MidiBuffer midi;
+    int noisePosition = 0;
+
+    auto fillInput = [&] {
+        if (noisePosition + blockSize > noise.getNumSamples()) {
+            noisePosition = 0;
+        }
+        for (int channel = 0; channel < 2; channel++) {
+            buffer.copyFrom(channel, 0, noise, channel, noisePosition, blockSize);
+        }
+        noisePosition += blockSize;
+    };
+
+    // half a second of warm up so the delay line and caches are populated
+    for (int i = 0; i < (int)(sampleRate * 0.5) / blockSize; i++) {
+        fillInput();
+        processor.processBlock(buffer, midi);
+    }
+
+    const int numBlocks = juce::jmax(1, (int)(sampleRate * seconds) / blockSize);
+    const juce::int64 allocationsBefore = ScopedAllocationGuard::getNumGuardedAllocations();
+    juce::int64 totalNanos = 0;
+    juce::int64 totalMisses = 0;
+    bool finite = true;
+
+    for (int i = 0; i < numBlocks; i++) {
+        fillInput();
+
+        cacheMisses.start();
+        const auto start = std::chrono::steady_clock::now();
+        processor.processBlock(buffer, midi);
+        const auto end = std::chrono::steady_clock::now();
+        totalMisses += cacheMisses.stop();
+
+        totalNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+        for (int channel = 0; channel < 2; channel++) {
+            const auto range = juce::FloatVectorOperations::findMinAndMax(buffer.getReadPointer(channel), blockSize);
+            finite = finite && std::isfinite(range.getStart()) && std::isfinite(range.getEnd());
+        }
+    }
+
+    processor.releaseResources();
+
+    BenchResult result;
+    result.nsPerSample = (double)totalNanos / ((double)numBlocks * blockSize);
+    result.allocationsPerBlock = (double)(ScopedAllocationGuard::getNumGuardedAllocations() - allocationsBefore) / numBlocks;
+    result.cacheMissesPerBlock = (double)totalMisses / numBlocks;
+    result.finite = finite;
+    return result;
+}
+
+//==============================================================================
+// Offline render of a fixed 4 s input at 48 kHz: bursts of noise with a
+// silence gap, and CCs moving Rate, Phase Offset, Feedback, Dry/Wet, Time Mode
+// and Type on samples that don't line up with any block size.
+// Returns the output interleaved.
+static std::vector<float> renderOffline(int type, int blockSize)
+{
+    const double sampleRate = 48000;
+    const int numSamples = 4 * (int)sampleRate;
+
+    TelayAudioProcessor processor;
+    processor.setNonRealtime(true);
+    setParameter(processor, "Type", (float)type);
+    processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+    processor.prepareToPlay(sampleRate, blockSize);
+
+    juce::AudioBuffer<float> input(2, numSamples);
+    input.clear();
+    juce::Random random(0x7e1a);
+    for (int i = 0; i < numSamples; i++) {
+        const bool gap = i >= numSamples / 4 && i < numSamples / 2;
+        if (! gap && i % 4800 < 480) {
+            const float x = (random.nextFloat() * 2 - 1) * 0.5f;
+            input.setSample(0, i, x);
+            input.setSample(1, i, x * 0.5f);
+        }
+    }
+
+    juce::MidiBuffer automation;
+    for (int i = 0; i < numSamples; i++) {
+        if (i % 3001 == 17) {
+            automation.addEvent(juce::MidiMessage::controllerEvent(1, 23, i / 3001 * 13 % 128), i);
+        }
+        if (i % 3001 == 400) {
+            automation.addEvent(juce::MidiMessage::controllerEvent(1, 24, i / 3001 * 7 % 128), i);
+        }
+        if (i % 5003 == 5) {
+            automation.addEvent(juce::MidiMessage::controllerEvent(1, 21, i / 5003 * 29 % 100), i);
+        }
+        if (i % 7919 == 3) {
+            automation.addEvent(juce::MidiMessage::controllerEvent(1, 20, i / 7919 * 41 % 128), i);
+        }
+        if (i % 11003 == 11) {
+            automation.addEvent(juce::MidiMessage::controllerEvent(1, 27, i / 11003 % 2 * 127), i);
+        }
+    }
+    // over to another type and back again
+    automation.addEvent(juce::MidiMessage::controllerEvent(1, 25, type == 0 ? 127 : 0), 70001);
+    automation.addEvent(juce::MidiMessage::controllerEvent(1, 25, type * 127 / (TelayAudioProcessor::numEffectTypes - 1)), 130001);
+
+    std::vector<float> output((size_t)numSamples * 2);
+    juce::AudioBuffer<float> buffer(2, blockSize);
+    juce::MidiBuffer midi;
+
+    for (int start = 0; start < numSamples; start += blockSize) {
+        const int length = juce::jmin(blockSize, numSamples - start);
+        buffer.setSize(2, length, false, false, true);
+        for (int channel = 0; channel < 2; channel++) {
+            buffer.copyFrom(channel, 0, input, channel, start, length);
+        }
+        midi.clear();
+        midi.addEvents(automation, start, length, -start);
+
+        processor.processBlock(buffer, midi);
+
+        for (int i = 0; i < length; i++) {
+            output[(size_t)(start + i) * 2] = buffer.getSample(0, i);
+            output[(size_t)(start + i) * 2 + 1] = buffer.getSample(1, i);
+        }
+    }
+
+    processor.releaseResources();
+    return output;
+}
+
+// index of the first sample whose bits differ, or -1
+static int findFirstDifference(const std::vector<float>& a, const std::vector<float>& b)
+{
+    for (size_t i = 0; i < a.size(); i++) {
+        if (std::memcmp(&a[i], &b[i], sizeof(float)) != 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+// FNV-1a over the render's bytes, enough to tell two renders apart
+static juce::String hashRender(const std::vector<float>& render)
+{
+    juce::uint64 hash = 0xcbf29ce484222325ULL;
+    const auto* bytes = reinterpret_cast<const juce::uint8*>(render.data());
+    for (size_t i = 0; i < render.size() * sizeof(float); i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return juce::String::toHexString((juce::int64)hash).paddedLeft('0', 16);
+}
+
+static bool checkDeterminism(const juce::File& golden, bool updateGolden)
+{
+    const int referenceBlock = 8192;
+    const int blocks[] = { 1, 2, 3, 7, 16, 64, 100, 256, 512, 1000, 1024, 4096 };
+    bool failed = false;
+    // one line per type, its name and the hash of its render
+    juce::StringArray hashes;
+
+    for (int type = 0; type < TelayAudioProcessor::numEffectTypes; type++) {
+        const auto reference = renderOffline(type, referenceBlock);
+        hashes.add(TelayAudioProcessor::getTypeName(type) + " " + hashRender(reference));
+
+        int numDiffering = 0;
+        for (int block : blocks) {
+            const int difference = findFirstDifference(reference, renderOffline(type, block));
+            if (difference >= 0) {
+                std::cerr << "FAIL: type " << type << " at " << block << " samples differs from " << referenceBlock
+                    << " samples from sample " << difference / 2 << std::endl;
+                numDiffering++;
+            }
+        }
+        std::cout << "type " << type << ": " << (int)std::size(blocks) - numDiffering << " of " << (int)std::size(blocks)
+            << " block sizes identical to " << referenceBlock << std::endl;
+        failed = failed || numDiffering > 0;
+    }
+
+    if (golden == juce::File()) {
+        return ! failed;
+    }
+
+    // a reference is only written on request, and not from renders that disagree
+    if (updateGolden) {
+        if (failed || ! golden.getParentDirectory().createDirectory()
+            || ! golden.replaceWithText(hashes.joinIntoString("\n") + "\n")) {
+            std::cerr << "FAIL: didn't write " << golden.getFullPathName() << std::endl;
+            return false;
+        }
+        std::cout << "wrote " << golden.getFullPathName() << std::endl;
+        return true;
+    }
+
+    if (! golden.existsAsFile()) {
+        std::cerr << "FAIL: no golden file " << golden.getFullPathName()
+            << ", write one from a trusted build with --update-golden" << std::endl;
+        return false;
+    }
+
+    juce::StringArray expected;
+    expected.addLines(golden.loadFileAsString());
+    expected.removeEmptyStrings();
+    for (int type = 0; type < TelayAudioProcessor::numEffectTypes; type++) {
+        if (type >= expected.size() || expected[type].trim() != hashes[type]) {
+            std::cerr << "FAIL: " << TelayAudioProcessor::getTypeName(type) << " differs from "
+                << golden.getFullPathName() << std::endl;
+            failed = true;
+        }
+    }
+    if (! failed) {
+        std::cout << "matches " << golden.getFullPathName() << std::endl;
+    }
+
+    return ! failed;
+}
+
+static juce::Array<int> parseList(const juce::String& text)
+{
+    juce::Array<int> values;
+    for (auto& token : juce::StringArray::fromTokens(text, ",", ""))
+        values.add(token.getIntValue());
+    return values;
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args(argc, argv);
+
+    if (args.containsOption("--help|-h")) {
+        std::cout << "TelayBench [--rates=44100,48000,...] [--blocks=16,64,...] [--oversampling=0,1,2] [--seconds=2] [--csv]"
+            << std::endl
+            << "TelayBench --check-determinism [--golden=<file> [--update-golden]]" << std::endl;
+        return 0;
+    }
+
+    if (args.containsOption("--check-determinism")) {
+        const auto golden = args.getValueForOption("--golden");
+        return checkDeterminism(golden.isNotEmpty() ? args.getFileForOption("--golden") : juce::File(),
+            args.containsOption("--update-golden")) ? 0 : 1;
+    }
+
+    const auto rates = parseList(args.getValueForOption("--rates").isNotEmpty()
+        ? args.getValueForOption("--rates") : "44100,48000,96000,192000");
+    const auto blocks = parseList(args.getValueForOption("--blocks").isNotEmpty()
+        ? args.getValueForOption("--blocks") : "16,64,256,1024,4096");
+    // 0 = off, 1 = 2x, 2 = 4x, only chorus and flanger are oversampled
+    const auto oversamplings = parseList(args.getValueForOption("--oversampling").isNotEmpty()
+        ? args.getValueForOption("--oversampling") : "0");
+    const double seconds = args.getValueForOption("--seconds").isNotEmpty()
+        ? args.getValueForOption("--seconds").getDoubleValue() : 2.0;
+    const bool csv = args.containsOption("--csv");
+
+    CacheMissCounter cacheMisses;
+#if ! TELAY_ALLOCATION_GUARD
+    std::cerr << "Built without TELAY_ALLOCATION_GUARD, allocations will read 0" << std::endl;
+#endif
+
+    if (csv) {
+        std::cout << "rate,block,type,ns_per_sample,allocs_per_block,cache_misses_per_block" << std::endl;
+    }
+    else {
+        std::cout << juce::String::formatted("%8s %6s %-11s %12s %14s %14s",
+            "rate", "block", "type", "ns/sample", "allocs/block", "misses/block") << std::endl;
+    }
+
+    bool failed = false;
+
+    for (int rate : rates) {
+        for (int block : blocks) {
+            for (int type = 0; type < TelayAudioProcessor::numEffectTypes; type++) {
+                for (int oversampling : oversamplings) {
+                    if (oversampling > 0 && type != TelayAudioProcessor::typeChorus
+                        && type != TelayAudioProcessor::typeFlanger) {
+                        continue;
+                    }
+
+                    const auto result = runConfiguration(rate, block, type, oversampling, seconds, cacheMisses);
+                    const juce::String misses = cacheMisses.isAvailable()
+                        ? juce::String(result.cacheMissesPerBlock, 1) : juce::String("n/a");
+                    const juce::String typeName = TelayAudioProcessor::getTypeName(type)
+                        + (oversampling > 0 ? " " + juce::String(1 << oversampling) + "x" : juce::String());
+
+                    if (csv) {
+                        std::cout << rate << "," << block << "," << typeName << ","
+                            << result.nsPerSample << "," << result.allocationsPerBlock << "," << misses << std::endl;
+                    }
+                    else {
+                        std::cout << juce::String::formatted("%8d %6d %-11s %12.3f %14.2f ",
+                            rate, block, typeName.toRawUTF8(), result.nsPerSample, result.allocationsPerBlock)
+                            << misses.paddedLeft(' ', 14) << std::endl;
+                    }
+
+                    if (result.allocationsPerBlock > 0 || ! result.finite) {
+                        std::cerr << "FAIL: " << rate << " Hz, " << block << " samples, " << typeName
+                            << (result.finite ? " allocated on the audio thread" : " produced non-finite output") << std::endl;
+                        failed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,115 @@
+/*
+  ==============================================================================
+
+    AllocationGuard.cpp
+
+  ==============================================================================
+*/
+
+#include "AllocationGuard.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// depth rather than a flag so guards can nest
+static thread_local int guardDepth = 0;
+static std::atomic<juce::int64> numGuardedAllocations { 0 };
+
+ScopedAllocationGuard::ScopedAllocationGuard() noexcept
+{
+    ++guardDepth;
+}
+
+ScopedAllocationGuard::~ScopedAllocationGuard() noexcept
+{
+    --guardDepth;
+}
+
+bool ScopedAllocationGuard::isActive() noexcept
+{
+    return guardDepth > 0;
+}
+
+juce::int64 ScopedAllocationGuard::getNumGuardedAllocations() noexcept
+{
+    return numGuardedAllocations.load(std::memory_order_relaxed);
+}
+
+#if TELAY_ALLOCATION_GUARD
+//==============================================================================
+// Replacement global allocation functions. Every form is replaced, the
+// standard doesn't promise the nothrow and aligned ones go through the plain one.
+static void countGuardedAllocation()
+{
+    if (guardDepth > 0) {
+        numGuardedAllocations.fetch_add(1, std::memory_order_relaxed);
+
+        // the assertion handler may allocate itself, so drop the guard while it runs
+        const int depth = guardDepth;
+        guardDepth = 0;
+        jassertfalse; // Heap allocation on the audio thread!
+        guardDepth = depth;
+    }
+}
+
+static void* guardedAlloc(std::size_t size) noexcept
+{
+    countGuardedAllocation();
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+// malloc'd with room to align, the pointer malloc returned is kept just before the block
+static void* guardedAlignedAlloc(std::size_t size, std::align_val_t alignment) noexcept
+{
+    countGuardedAllocation();
+    const std::size_t align = juce::jmax((std::size_t)alignment, sizeof(void*));
+    void* raw = std::malloc(size + align + sizeof(void*));
+    if (raw == nullptr) {
+        return nullptr;
+    }
+    const auto address = (reinterpret_cast<std::uintptr_t>(raw) + sizeof(void*) + align - 1) & ~(std::uintptr_t)(align - 1);
+    void* ptr = reinterpret_cast<void*>(address);
+    static_cast<void**>(ptr)[-1] = raw;
+    return ptr;
+}
+
+static void guardedAlignedFree(void* ptr) noexcept
+{
+    if (ptr != nullptr) {
+        std::free(static_cast<void**>(ptr)[-1]);
+    }
+}
+
+static void* throwIfNull(void* ptr)
+{
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new(std::size_t size)                                    { return throwIfNull(guardedAlloc(size)); }
+void* operator new[](std::size_t size)                                  { return throwIfNull(guardedAlloc(size)); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept     { return guardedAlloc(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept   { return guardedAlloc(size); }
+void operator delete(void* ptr) noexcept                                { std::free(ptr); }
+void operator delete[](void* ptr) noexcept                              { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept                   { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept                 { std::free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept         { std::free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept       { std::free(ptr); }
+
+void* operator new(std::size_t size, std::align_val_t alignment)        { return throwIfNull(guardedAlignedAlloc(size, alignment)); }
+void* operator new[](std::size_t size, std::align_val_t alignment)      { return throwIfNull(guardedAlignedAlloc(size, alignment)); }
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+    { return guardedAlignedAlloc(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+    { return guardedAlignedAlloc(size, alignment); }
+void operator delete(void* ptr, std::align_val_t) noexcept              { guardedAlignedFree(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept            { guardedAlignedFree(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept    { guardedAlignedFree(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept  { guardedAlignedFree(ptr); }
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept   { guardedAlignedFree(ptr); }
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { guardedAlignedFree(ptr); }
+#endif
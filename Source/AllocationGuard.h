@@ -0,0 +1,45 @@
+/*
+  ==============================================================================
+
+    AllocationGuard.h
+
+    Debug helper that catches heap allocations made on the audio thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Enabled for debug builds by default. Define TELAY_ALLOCATION_GUARD=1 to keep
+// it in a release build (e.g. a soak-test build for unattended installs).
+#ifndef TELAY_ALLOCATION_GUARD
+ #if JUCE_DEBUG
+  #define TELAY_ALLOCATION_GUARD 1
+ #else
+  #define TELAY_ALLOCATION_GUARD 0
+ #endif
+#endif
+
+//==============================================================================
+/**
+    Put one of these at the top of processBlock. While it is alive, any call to
+    any form of the global operator new on the same thread is counted and hits a jassert.
+*/
+class ScopedAllocationGuard
+{
+public:
+    ScopedAllocationGuard() noexcept;
+    ~ScopedAllocationGuard() noexcept;
+
+    // true if the calling thread is currently inside a guarded scope
+    static bool isActive() noexcept;
+
+    // Total allocations made inside guarded scopes on any thread. Always 0
+    // unless TELAY_ALLOCATION_GUARD is enabled.
+    static juce::int64 getNumGuardedAllocations() noexcept;
+
+private:
+    JUCE_DECLARE_NON_COPYABLE(ScopedAllocationGuard)
+};
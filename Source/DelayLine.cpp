@@ -0,0 +1,322 @@
+/*
+  ==============================================================================
+
+    DelayLine.cpp
+
+  ==============================================================================
+*/
+
+#include "DelayLine.h"
+
+// stale samples zeroed per sample written while warming up after a reset
+static const int warmUpZeroRate = 3;
+
+// past this many channels the rings grow to what is asked for, no more
+static const int maxGrownChannels = 16;
+
+DelayLine::DelayLine()
+{
+    mBuffer = nullptr;
+    mNumChannels = 0;
+    mChannelStride = 0;
+    mReservedCapacity = 0;
+    mMask = 0;
+    mWriteHead = 0;
+    mValid = 0;
+    mZeroHead = 0;
+}
+
+void DelayLine::prepare(int numChannels, int maximumDelayInSamples, int reservedDelayInSamples)
+{
+    jassert(numChannels > 0 && maximumDelayInSamples > 0);
+
+    // one extra sample so a fractional read at the maximum still has its pair
+    const int capacity = juce::nextPowerOfTwo(maximumDelayInSamples + 2);
+
+    // reserving more than is used only pays off if the rest costs nothing
+    int reservedCapacity = capacity;
+    if (ReservedMemory::isLazy()) {
+        reservedCapacity = juce::jmax(capacity, juce::nextPowerOfTwo(reservedDelayInSamples + 2));
+    }
+
+    // Hosts call prepareToPlay on every transport start and bounce, so rings that
+    // still fit are kept and only reset, which doesn't touch their memory
+    if (mBuffer != nullptr && reservedCapacity <= mReservedCapacity && numChannels <= getReservedChannels()) {
+        mNumChannels = numChannels;
+        mMask = capacity - 1;
+        mWriteHead &= mMask;
+        reset();
+        return;
+    }
+
+    // otherwise grow geometrically, the capacity by at least a power of two
+    // already, the number of rings by doubling
+    int reservedChannels = numChannels;
+    if (mBuffer != nullptr) {
+        reservedCapacity = juce::jmax(reservedCapacity, mReservedCapacity);
+        reservedChannels = juce::jmax(numChannels, juce::jmin(2 * getReservedChannels(), maxGrownChannels));
+    }
+
+    // keep every ring starting on a 64 byte boundary relative to the first one
+    mChannelStride = (reservedCapacity + guardSamples + 15) & ~15;
+    mNumChannels = numChannels;
+    mReservedCapacity = reservedCapacity;
+    mMask = capacity - 1;
+
+    mBuffer = nullptr;
+    if (! mMemory.reserve(sizeof(float) * (size_t)mChannelStride * (size_t)reservedChannels)) {
+        throw std::bad_alloc();
+    }
+    mBuffer = (float*)mMemory.getData();
+
+    // fresh memory is already zero
+    mWriteHead = 0;
+    mValid = capacity;
+    mZeroHead = 0;
+}
+
+bool DelayLine::setMaximumDelay(int maximumDelayInSamples) noexcept
+{
+    const int capacity = juce::nextPowerOfTwo(maximumDelayInSamples + 2);
+    if (capacity > mReservedCapacity) {
+        return false;
+    }
+
+    if (capacity != getCapacity()) {
+        mMask = capacity - 1;
+        mWriteHead &= mMask;
+        reset();
+    }
+    return true;
+}
+
+void DelayLine::clear()
+{
+    if (mBuffer == nullptr) {
+        return;
+    }
+
+    // the whole stride, so anything left over from a longer maximum goes too
+    bool decommitted = true;
+    for (int channel = 0; channel < mNumChannels; channel++) {
+        decommitted = mMemory.decommit(sizeof(float) * (size_t)channel * (size_t)mChannelStride,
+            sizeof(float) * (size_t)mChannelStride) && decommitted;
+    }
+
+    if (decommitted) {
+        mWriteHead = 0;
+        mValid = getCapacity();
+    }
+    else {
+        reset();
+    }
+}
+
+void DelayLine::reset() noexcept
+{
+    mValid = 0;
+    mZeroHead = mWriteHead;
+
+    // Start with a margin of zeroes behind the last real sample. A kernel that
+    // reaches past it then only sees zeroes and stale samples, and maskStale()
+    // can replace its output with silence without cutting into real signal.
+    zeroStale(2 * guardSamples);
+}
+
+void DelayLine::warmUp(int numSamples) noexcept
+{
+    mValid = juce::jmin(getCapacity(), mValid + numSamples);
+    zeroStale(warmUpZeroRate * numSamples);
+}
+
+void DelayLine::zeroStale(int numSamples) noexcept
+{
+    numSamples = juce::jmin(numSamples, getCapacity() - mValid);
+    if (numSamples <= 0) {
+        return;
+    }
+
+    // work backwards from the oldest valid sample, the same span in every ring
+    const int end = mZeroHead;
+    const int start = (end - numSamples) & mMask;
+    const bool wraps = start >= end;
+
+    for (int channel = 0; channel < mNumChannels; channel++) {
+        float* data = getChannel(channel);
+        if (wraps) {
+            std::fill(data + start, data + getCapacity(), 0.0f);
+            std::fill(data, data + end, 0.0f);
+        }
+        else {
+            std::fill(data + start, data + end, 0.0f);
+        }
+
+        if (wraps || start < guardSamples) {
+            std::copy(data, data + guardSamples, data + getCapacity());
+        }
+    }
+
+    mZeroHead = start;
+    mValid += numSamples;
+}
+
+void DelayLine::maskStale(const float* delays, float* output, int numSamples) const noexcept
+{
+    // a sample whose kernel could reach back past the valid samples reads as silence
+    for (int i = 0; i < numSamples; i++) {
+        if (delays[i] > (float)(mValid + i + 1 - guardSamples)) {
+            output[i] = 0.0f;
+        }
+    }
+}
+
+void DelayLine::write(int channel, const float* samples, int numSamples) noexcept
+{
+    jassert(juce::isPositiveAndBelow(channel, mNumChannels));
+    jassert(numSamples <= getCapacity());
+
+    float* data = getChannel(channel);
+    const int capacity = getCapacity();
+
+    // at most two runs, up to the end of the ring and then from its start
+    const int firstRun = juce::jmin(numSamples, capacity - mWriteHead);
+    std::copy(samples, samples + firstRun, data + mWriteHead);
+    std::copy(samples + firstRun, samples + numSamples, data);
+
+    // refresh the mirror if the start of the ring was touched
+    if (mWriteHead < guardSamples || firstRun < numSamples) {
+        std::copy(data, data + guardSamples, data + capacity);
+    }
+}
+
+int DelayLine::getLookahead(Interpolation kernel) noexcept
+{
+    switch (kernel) {
+    case Interpolation::hermite:  return Interpolators::Hermite::numTaps / 2;
+    case Interpolation::lagrange: return Interpolators::Lagrange::numTaps / 2;
+    case Interpolation::sinc:     return Interpolators::WindowedSinc::numTaps / 2;
+    // the allpass may pull its integer tap one sample closer
+    case Interpolation::allpass:  return 2;
+    case Interpolation::linear:
+    default:                      return 1;
+    }
+}
+
+void DelayLine::read(Interpolation kernel, int channel, const float* delays, float* output, int numSamples,
+    float& allpassState) const noexcept
+{
+    switch (kernel) {
+    case Interpolation::hermite:
+        readWithKernel<Interpolators::Hermite>(channel, delays, output, numSamples);
+        break;
+    case Interpolation::lagrange:
+        readWithKernel<Interpolators::Lagrange>(channel, delays, output, numSamples);
+        break;
+    case Interpolation::allpass:
+        readAllpass(channel, delays, output, numSamples, allpassState);
+        break;
+    case Interpolation::sinc:
+        readWithKernel<Interpolators::WindowedSinc>(channel, delays, output, numSamples);
+        break;
+    case Interpolation::linear:
+    default:
+        readWithKernel<Interpolators::Linear>(channel, delays, output, numSamples);
+        break;
+    }
+
+    if (mValid < getCapacity() && kernel != Interpolation::allpass) {
+        maskStale(delays, output, numSamples);
+    }
+}
+
+void DelayLine::readInteger(int channel, int delayInSamples, float* output, int numSamples) const noexcept
+{
+    // the newest sample read has to be written already
+    jassert(delayInSamples > numSamples);
+
+    const float* data = getChannel(channel);
+    const int start = (mWriteHead + 1 - delayInSamples) & mMask;
+
+    // at most two runs, like write()
+    const int firstRun = juce::jmin(numSamples, getCapacity() - start);
+    std::copy(data + start, data + start + firstRun, output);
+    std::copy(data, data + numSamples - firstRun, output + firstRun);
+
+    // same rule as maskStale(), for one delay
+    if (mValid < getCapacity()) {
+        const int numStale = juce::jlimit(0, numSamples, delayInSamples - mValid - 1 + guardSamples);
+        std::fill(output, output + numStale, 0.0f);
+    }
+}
+
+template <typename Kernel>
+void DelayLine::readWithKernel(int channel, const float* delays, float* output, int numSamples) const noexcept
+{
+    constexpr int numTaps = Kernel::numTaps;
+    const float* data = getChannel(channel);
+
+    // For output sample i at delay whole + fraction, the oldest tap is
+    // whole + numTaps / 2 samples old, measured after sample i is written
+    const int base = mWriteHead + 1 - numTaps / 2;
+    int i = 0;
+
+#if JUCE_USE_SIMD
+    // The buffer reads are a gather, so they stay scalar; the kernel itself
+    // runs on full SIMD registers, several output samples at once.
+    // output must be SIMD aligned.
+    using Vec = juce::dsp::SIMDRegister<float>;
+    constexpr int lanes = (int)Vec::SIMDNumElements;
+    alignas(Vec::SIMDRegisterSize) float taps[(size_t)numTaps][(size_t)lanes];
+    alignas(Vec::SIMDRegisterSize) float positions[(size_t)lanes];
+
+    jassert(Vec::isSIMDAligned(output));
+
+    for (; i + lanes <= numSamples; i += lanes) {
+        for (int lane = 0; lane < lanes; lane++) {
+            const float delay = delays[i + lane];
+            const int whole = (int)delay;
+            const float* p = data + ((base + i + lane - whole) & mMask);
+            for (int tap = 0; tap < numTaps; tap++) {
+                taps[tap][lane] = p[tap];
+            }
+            positions[lane] = 1 - (delay - whole);
+        }
+
+        Vec tapVecs[(size_t)numTaps];
+        for (int tap = 0; tap < numTaps; tap++) {
+            tapVecs[tap] = Vec::fromRawArray(taps[tap]);
+        }
+        Kernel::interpolate(tapVecs, Vec::fromRawArray(positions)).copyToRawArray(output + i);
+    }
+#endif
+
+    for (; i < numSamples; i++) {
+        const float delay = delays[i];
+        const int whole = (int)delay;
+
+        // the guard region makes the taps contiguous even across the wrap
+        const float* p = data + ((base + i - whole) & mMask);
+        output[i] = Kernel::interpolate(p, 1 - (delay - whole));
+    }
+}
+
+void DelayLine::readAllpass(int channel, const float* delays, float* output, int numSamples, float& state) const noexcept
+{
+    const float* data = getChannel(channel);
+    float y = state;
+
+    // the filter state would carry stale samples on, so they are read as silence rather than masked afterwards
+    static const float silence[2] = { 0.0f, 0.0f };
+    const float staleDelay = mValid < getCapacity() ? (float)(mValid + 1 - guardSamples) : (float)getCapacity();
+
+    for (int i = 0; i < numSamples; i++) {
+        const int whole = (int)(delays[i] - Interpolators::Allpass::minFraction);
+        const float fraction = delays[i] - whole;
+
+        // p[0] is whole + 1 samples old, p[1] is whole samples old
+        const float* p = delays[i] > staleDelay + i ? silence : data + ((mWriteHead + i - whole) & mMask);
+        output[i] = Interpolators::Allpass::interpolate(p, fraction, y);
+    }
+
+    state = y;
+}
@@ -0,0 +1,122 @@
+/*
+  ==============================================================================
+
+    DelayLine.h
+
+    Multichannel power-of-two circular buffer. All channels live in one
+    allocation (one ring after another) and share a write head. Indices wrap
+    with a bitmask, and the first few samples of each ring are mirrored past
+    its end so interpolators can read a run of contiguous samples from any
+    position without wrap checks.
+
+    Each ring sits in room reserved for a longer maximum, so the maximum can
+    change on the audio thread. Where the platform commits memory lazily the
+    untouched part of that room costs no RAM.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+#include "Interpolators.h"
+#include "ReservedMemory.h"
+
+//==============================================================================
+/**
+*/
+class DelayLine
+{
+public:
+    // Number of contiguous samples that can be read from any read pointer,
+    // enough for the widest interpolation kernel
+    static constexpr int guardSamples = Interpolators::WindowedSinc::numTaps;
+
+    DelayLine();
+
+    // Allocates room for at least maximumDelayInSamples per channel, zeroed. With
+    // lazy commit, room for reservedDelayInSamples is reserved as well so that
+    // setMaximumDelay() can grow up to it later; otherwise that is ignored.
+    // If the current allocation is big enough it is kept and only reset().
+    void prepare(int numChannels, int maximumDelayInSamples, int reservedDelayInSamples = 0);
+
+    // Resizes the rings within the reserved room and resets them. Never allocates.
+    // Returns false, changing nothing, if the new maximum doesn't fit.
+    bool setMaximumDelay(int maximumDelayInSamples) noexcept;
+
+    // Zeroes every ring, handing the pages back to the OS where it can, which
+    // is quick however long the rings are. Not for the audio thread.
+    void clear();
+
+    // Forgets the contents without touching memory, safe on the audio thread.
+    // Reads behave as if the rings were zeroed; the stale samples are zeroed a
+    // few at a time behind the write head as it moves on.
+    void reset() noexcept;
+
+    int getNumChannels() const noexcept { return mNumChannels; }
+    int getCapacity() const noexcept { return mMask + 1; }
+
+    // Copies numSamples into the ring of one channel, starting at the write head.
+    // Call this for every channel, then advance() once.
+    void write(int channel, const float* samples, int numSamples) noexcept;
+    void advance(int numSamples) noexcept {
+        mWriteHead = (mWriteHead + numSamples) & mMask;
+        if (mValid < getCapacity()) {
+            warmUp(numSamples);
+        }
+    }
+
+    // Pointer to the sample written delayInSamples samples before the write head
+    // (1 == the latest one). The following guardSamples - 1 entries are the newer
+    // samples, in order.
+    inline const float* getReadPointer(int channel, int delayInSamples) const noexcept {
+        return getChannel(channel) + ((mWriteHead - delayInSamples) & mMask);
+    }
+
+    // Interpolated reads for a block that is about to be written.
+    // delays[i] is the delay of output sample i, measured as if samples 0..i
+    // had already been written, so a block can be read before its write() as
+    // long as every delay is at least numSamples + getLookahead(kernel).
+    // allpassState is the read head's filter state, only used by the allpass.
+    void read(Interpolation kernel, int channel, const float* delays, float* output, int numSamples,
+        float& allpassState) const noexcept;
+
+    // Fast path for a delay that is a whole number of samples and holds for the
+    // whole block: a plain copy, no interpolation. Same timing as read().
+    void readInteger(int channel, int delayInSamples, float* output, int numSamples) const noexcept;
+
+    // How many samples past the fractional read position a kernel looks
+    static int getLookahead(Interpolation kernel) noexcept;
+
+private:
+    template <typename Kernel>
+    void readWithKernel(int channel, const float* delays, float* output, int numSamples) const noexcept;
+    void readAllpass(int channel, const float* delays, float* output, int numSamples, float& state) const noexcept;
+
+    void warmUp(int numSamples) noexcept;
+    void zeroStale(int numSamples) noexcept;
+    void maskStale(const float* delays, float* output, int numSamples) const noexcept;
+
+    int getReservedChannels() const noexcept {
+        return mChannelStride > 0 ? (int)(mMemory.getSize() / (sizeof(float) * (size_t)mChannelStride)) : 0;
+    }
+
+    inline float* getChannel(int channel) const noexcept {
+        return mBuffer + channel * mChannelStride;
+    }
+
+    ReservedMemory mMemory;
+    float* mBuffer;
+    int mNumChannels;
+    int mChannelStride;
+    int mReservedCapacity;
+    int mMask;
+    int mWriteHead;
+
+    // After a reset only the mValid samples before the write head can be read,
+    // older ones are stale. mZeroHead is where zeroing the stale ones carries on.
+    int mValid;
+    int mZeroHead;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DelayLine)
+};
@@ -0,0 +1,248 @@
+/*
+  ==============================================================================
+
+    FeedbackChain.cpp
+
+  ==============================================================================
+*/
+
+#include "FeedbackChain.h"
+
+// Butterworth damping, no resonant peak for the loop to build up on
+static const float svfDamping = juce::MathConstants<float>::sqrt2;
+
+// 12 dB into the clipper at full drive
+static const float maxDriveGain = 4.0f;
+
+// a slow wow and a faster flutter, rates in Hz and full depths in seconds
+static const double wowRate = 0.7;
+static const double flutterRate = 6.5;
+static const float wowDepth = 0.0015f;
+static const float flutterDepth = 0.00012f;
+
+// time for the wow and flutter depth to go from off to full
+static const double depthRampTime = 0.05;
+
+// samples between exact restarts of the transport oscillators, a power of two
+static const int resyncInterval = 256;
+
+static const int numStates = 4;
+
+FeedbackChain::FeedbackChain()
+{
+    mNumChannels = 0;
+    mStateChannels = 0;
+    mSampleRate = 0.0;
+    mLowCut = minLowCut;
+    mHighCut = maxHighCut;
+    mLowCutOn = false;
+    mHighCutOn = false;
+    mLowCutSvf = { 1.0f, 0.0f, 0.0f };
+    mHighCutSvf = { 1.0f, 0.0f, 0.0f };
+    mDriveGain = 1.0f;
+    mWowFlutter = 0.0f;
+    mWowFlutterDepth = 0.0f;
+    mWowCos = 1.0f;
+    mWowSin = 0.0f;
+    mFlutterCos = 1.0f;
+    mFlutterSin = 0.0f;
+    mWowRotation[0] = 1.0f;
+    mWowRotation[1] = 0.0f;
+    mFlutterRotation[0] = 1.0f;
+    mFlutterRotation[1] = 0.0f;
+    mWowAngle = 0.0;
+    mFlutterAngle = 0.0;
+    mTransportPosition = 0;
+}
+
+void FeedbackChain::prepare(int numChannels)
+{
+    mNumChannels = numChannels;
+
+    // the state is only reallocated for more channels than it has room for
+    if (numChannels > mStateChannels) {
+        mState.allocate((size_t)(numStates * numChannels), true);
+        mStateChannels = numChannels;
+    }
+    else {
+        reset();
+    }
+}
+
+void FeedbackChain::reset() noexcept
+{
+    juce::FloatVectorOperations::clear(mState.get(), numStates * mNumChannels);
+}
+
+FeedbackChain::SvfCoefficients FeedbackChain::makeSvf(float cutoffHz, double sampleRate) noexcept
+{
+    // prewarped, and kept clear of Nyquist where tan() runs away
+    const float g = (float)std::tan(juce::MathConstants<double>::pi * juce::jmin((double)cutoffHz, sampleRate * 0.49) / sampleRate);
+    SvfCoefficients svf;
+    svf.a1 = 1 / (1 + g * (g + svfDamping));
+    svf.a2 = g * svf.a1;
+    svf.a3 = g * svf.a2;
+    return svf;
+}
+
+void FeedbackChain::setParameters(float lowCutHz, float highCutHz, float drive, float wowFlutter, double sampleRate) noexcept
+{
+    const bool rateChanged = ! juce::exactlyEqual(sampleRate, mSampleRate);
+    mSampleRate = sampleRate;
+
+    // the coefficients are only recalculated when a cutoff or the rate moves
+    if (rateChanged || ! juce::exactlyEqual(lowCutHz, mLowCut)) {
+        mLowCut = lowCutHz;
+        mLowCutSvf = makeSvf(lowCutHz, sampleRate);
+    }
+    if (rateChanged || ! juce::exactlyEqual(highCutHz, mHighCut)) {
+        mHighCut = highCutHz;
+        mHighCutSvf = makeSvf(highCutHz, sampleRate);
+    }
+    if (rateChanged) {
+        mWowAngle = juce::MathConstants<double>::twoPi * wowRate / sampleRate;
+        mFlutterAngle = juce::MathConstants<double>::twoPi * flutterRate / sampleRate;
+        mWowRotation[0] = (float)std::cos(mWowAngle);
+        mWowRotation[1] = (float)std::sin(mWowAngle);
+        mFlutterRotation[0] = (float)std::cos(mFlutterAngle);
+        mFlutterRotation[1] = (float)std::sin(mFlutterAngle);
+        mTransportPosition = 0;
+    }
+
+    // A filter switched back on starts from rest rather than from wherever it was
+    const bool lowCutOn = lowCutHz > minLowCut;
+    const bool highCutOn = highCutHz < maxHighCut;
+    for (int channel = 0; channel < mNumChannels; channel++) {
+        float* state = mState.get() + channel * numStates;
+        if (lowCutOn && ! mLowCutOn) {
+            state[0] = state[1] = 0.0f;
+        }
+        if (highCutOn && ! mHighCutOn) {
+            state[2] = state[3] = 0.0f;
+        }
+    }
+    mLowCutOn = lowCutOn;
+    mHighCutOn = highCutOn;
+
+    mDriveGain = 1 + (maxDriveGain - 1) * juce::jlimit(0.0f, 1.0f, drive);
+    mWowFlutter = juce::jlimit(0.0f, 1.0f, wowFlutter);
+}
+
+float FeedbackChain::getMaxModulation() const noexcept
+{
+    return juce::jmax(mWowFlutter, mWowFlutterDepth) * (wowDepth + flutterDepth) * (float)mSampleRate;
+}
+
+template <bool lowCut, bool saturate, bool highCut>
+void FeedbackChain::processWith(float* state, float* samples, int numSamples) const noexcept
+{
+    // The filters are recursive, so this can't run across samples in SIMD.
+    // Instead every stage runs in the one loop with its state in registers.
+    const SvfCoefficients lc = mLowCutSvf;
+    const SvfCoefficients hc = mHighCutSvf;
+    const float driveGain = mDriveGain;
+    const float makeUp = 1 / mDriveGain;
+    float lc1 = state[0], lc2 = state[1], hc1 = state[2], hc2 = state[3];
+
+    for (int i = 0; i < numSamples; i++) {
+        float x = samples[i];
+
+        // the low cut comes first so rumble and DC don't push the clipper off centre
+        if constexpr (lowCut) {
+            const float v3 = x - lc2;
+            const float v1 = lc.a1 * lc1 + lc.a2 * v3;
+            const float v2 = lc2 + lc.a2 * lc1 + lc.a3 * v3;
+            lc1 = 2 * v1 - lc1;
+            lc2 = 2 * v2 - lc2;
+            x = x - svfDamping * v1 - v2;
+        }
+
+        // cubic soft clip, unity gain for small signals and flat from 1.5 up
+        if constexpr (saturate) {
+            const float driven = juce::jlimit(-1.5f, 1.5f, x * driveGain);
+            x = (driven - (4.0f / 27.0f) * driven * driven * driven) * makeUp;
+        }
+
+        // and the high cut last, which takes the edge off what the clipper added
+        if constexpr (highCut) {
+            const float v3 = x - hc2;
+            const float v1 = hc.a1 * hc1 + hc.a2 * v3;
+            const float v2 = hc2 + hc.a2 * hc1 + hc.a3 * v3;
+            hc1 = 2 * v1 - hc1;
+            hc2 = 2 * v2 - hc2;
+            x = v2;
+        }
+
+        samples[i] = x;
+    }
+
+    state[0] = lc1;
+    state[1] = lc2;
+    state[2] = hc1;
+    state[3] = hc2;
+}
+
+void FeedbackChain::process(int channel, float* samples, int numSamples) noexcept
+{
+    jassert(juce::isPositiveAndBelow(channel, mNumChannels));
+    float* state = mState.get() + channel * numStates;
+
+    // one specialised loop per combination of stages that are switched on
+    const int stages = (mLowCutOn ? 4 : 0) | (mDriveGain > 1.0f ? 2 : 0) | (mHighCutOn ? 1 : 0);
+    switch (stages) {
+    case 1: processWith<false, false, true>(state, samples, numSamples); break;
+    case 2: processWith<false, true, false>(state, samples, numSamples); break;
+    case 3: processWith<false, true, true>(state, samples, numSamples); break;
+    case 4: processWith<true, false, false>(state, samples, numSamples); break;
+    case 5: processWith<true, false, true>(state, samples, numSamples); break;
+    case 6: processWith<true, true, false>(state, samples, numSamples); break;
+    case 7: processWith<true, true, true>(state, samples, numSamples); break;
+    default: break;
+    }
+}
+
+void FeedbackChain::modulate(float* offsets, int numSamples) noexcept
+{
+    const float wowScale = wowDepth * (float)mSampleRate;
+    const float flutterScale = flutterDepth * (float)mSampleRate;
+
+    // the depth ramps to its new setting at a fixed rate so turning the knob doesn't click
+    float depth = mWowFlutterDepth;
+    const float target = mWowFlutter;
+    const float depthStep = (float)(1.0 / (depthRampTime * mSampleRate));
+
+    float wowCos = mWowCos, wowSin = mWowSin;
+    float flutterCos = mFlutterCos, flutterSin = mFlutterSin;
+
+    for (int i = 0; i < numSamples; i++) {
+        // Rotating builds up rounding error, so every so often the oscillators are
+        // set exactly. That happens at fixed positions, whatever the chunk lengths.
+        if ((mTransportPosition & (resyncInterval - 1)) == 0) {
+            const double wowPhase = std::fmod((double)mTransportPosition * mWowAngle, juce::MathConstants<double>::twoPi);
+            const double flutterPhase = std::fmod((double)mTransportPosition * mFlutterAngle, juce::MathConstants<double>::twoPi);
+            wowCos = (float)std::cos(wowPhase);
+            wowSin = (float)std::sin(wowPhase);
+            flutterCos = (float)std::cos(flutterPhase);
+            flutterSin = (float)std::sin(flutterPhase);
+        }
+        mTransportPosition++;
+
+        if (! juce::exactlyEqual(depth, target)) {
+            depth = depth < target ? juce::jmin(target, depth + depthStep) : juce::jmax(target, depth - depthStep);
+        }
+        offsets[i] = depth * (wowScale * wowSin + flutterScale * flutterSin);
+
+        const float wc = wowCos * mWowRotation[0] - wowSin * mWowRotation[1];
+        wowSin = wowSin * mWowRotation[0] + wowCos * mWowRotation[1];
+        wowCos = wc;
+        const float fc = flutterCos * mFlutterRotation[0] - flutterSin * mFlutterRotation[1];
+        flutterSin = flutterSin * mFlutterRotation[0] + flutterCos * mFlutterRotation[1];
+        flutterCos = fc;
+    }
+
+    mWowCos = wowCos;
+    mWowSin = wowSin;
+    mFlutterCos = flutterCos;
+    mFlutterSin = flutterSin;
+    mWowFlutterDepth = depth;
+}
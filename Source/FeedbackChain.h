@@ -0,0 +1,96 @@
+/*
+  ==============================================================================
+
+    FeedbackChain.h
+
+    Tone shaping for the feedback loop: a low cut, a soft clip saturator and
+    a high cut, run in one fused pass over each chunk, plus the wow and
+    flutter of a worn tape transport as an offset on the read time. Every
+    stage switches itself off at its neutral setting.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+
+//==============================================================================
+/**
+*/
+class FeedbackChain
+{
+public:
+    // cutoffs at or past these leave their filter out
+    static constexpr float minLowCut = 20.0f;
+    static constexpr float maxHighCut = 20000.0f;
+
+    FeedbackChain();
+
+    // Sizes the filter state, call from prepareToPlay
+    void prepare(int numChannels);
+
+    // Clears the filter state, the transport keeps running
+    void reset() noexcept;
+
+    // Settings for the next process() and modulate(), at the rate they run at.
+    // Drive and wow/flutter go from 0 (off) to 1.
+    void setParameters(float lowCutHz, float highCutHz, float drive, float wowFlutter, double sampleRate) noexcept;
+
+    bool isActive() const noexcept { return mLowCutOn || mHighCutOn || mDriveGain > 1.0f; }
+    bool hasWowFlutter() const noexcept { return mWowFlutter > 0.0f || mWowFlutterDepth > 0.0f; }
+
+    // the furthest modulate() moves the read time either way, in samples
+    float getMaxModulation() const noexcept;
+
+    // Filters and saturates one channel's feedback signal in place
+    void process(int channel, float* samples, int numSamples) noexcept;
+
+    // Fills offsets with numSamples of wow and flutter in samples, shared by every
+    // channel like one tape transport
+    void modulate(float* offsets, int numSamples) noexcept;
+
+private:
+    // Zavalishin's topology preserving SVF, two integrator states per filter
+    struct SvfCoefficients
+    {
+        float a1, a2, a3;
+    };
+
+    static SvfCoefficients makeSvf(float cutoffHz, double sampleRate) noexcept;
+
+    template <bool lowCut, bool saturate, bool highCut>
+    void processWith(float* state, float* samples, int numSamples) const noexcept;
+
+    int mNumChannels;
+    double mSampleRate;
+
+    float mLowCut;
+    float mHighCut;
+    bool mLowCutOn;
+    bool mHighCutOn;
+    SvfCoefficients mLowCutSvf;
+    SvfCoefficients mHighCutSvf;
+
+    // pre-gain into the clipper, which is divided out again after it
+    float mDriveGain;
+
+    // the depth in use ramps towards the setting
+    float mWowFlutter;
+    float mWowFlutterDepth;
+
+    // quadrature oscillators, rotated by a fixed angle per sample
+    float mWowCos, mWowSin;
+    float mFlutterCos, mFlutterSin;
+    float mWowRotation[2];
+    float mFlutterRotation[2];
+    double mWowAngle;
+    double mFlutterAngle;
+    juce::int64 mTransportPosition;
+
+    // low cut and high cut states per channel, with room for mStateChannels
+    juce::HeapBlock<float> mState;
+    int mStateChannels;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FeedbackChain)
+};
@@ -0,0 +1,64 @@
+/*
+  ==============================================================================
+
+    Interpolators.cpp
+
+  ==============================================================================
+*/
+
+#include "Interpolators.h"
+
+namespace Interpolators
+{
+    // zeroth order modified Bessel function, for the Kaiser window
+    static double besselI0(double x)
+    {
+        double sum = 1.0;
+        double term = 1.0;
+        for (int k = 1; k < 32; k++) {
+            term *= (x / (2 * k)) * (x / (2 * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    const float* WindowedSinc::getTable()
+    {
+        // built once on first use, the processor touches it from its constructor
+        static const std::vector<float> table = [] {
+            constexpr double beta = 6.0;
+            constexpr int half = numTaps / 2;
+            std::vector<float> t((numPhases + 2) * numTaps);
+
+            // the extra row lets getWeights interpolate at t == 1
+            for (int phase = 0; phase < numPhases + 2; phase++) {
+                const double position = (double)phase / numPhases;
+                double weights[numTaps];
+                double sum = 0;
+
+                for (int tap = 0; tap < numTaps; tap++) {
+                    // distance from the interpolation point to this tap
+                    const double u = position - (tap - (half - 1));
+                    // exact zeros at the other whole samples, so a whole-sample delay reads
+                    // back exactly what the plain copy in DelayLine::readInteger() does
+                    double sinc = juce::exactlyEqual(u, 0.0) ? 1.0
+                        : std::sin(juce::MathConstants<double>::pi * u) / (juce::MathConstants<double>::pi * u);
+                    if (! juce::exactlyEqual(u, 0.0) && juce::exactlyEqual(u, std::floor(u))) {
+                        sinc = 0.0;
+                    }
+                    const double ratio = juce::jlimit(-1.0, 1.0, u / half);
+                    const double window = besselI0(beta * std::sqrt(1 - ratio * ratio)) / besselI0(beta);
+                    weights[tap] = sinc * window;
+                    sum += weights[tap];
+                }
+
+                // unity gain at DC for every phase
+                for (int tap = 0; tap < numTaps; tap++) {
+                    t[(size_t)(phase * numTaps + tap)] = (float)(weights[tap] / sum);
+                }
+            }
+            return t;
+        }();
+        return table.data();
+    }
+}
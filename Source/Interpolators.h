@@ -0,0 +1,145 @@
+/*
+  ==============================================================================
+
+    Interpolators.h
+
+    Fractional delay kernels. Each kernel reads numTaps contiguous samples,
+    oldest first, and interpolates at position t between taps
+    numTaps / 2 - 1 (t == 0) and numTaps / 2 (t == 1).
+
+    The polynomial kernels are templates so the same code runs on plain
+    floats and on juce::dsp::SIMDRegister lanes.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+
+enum class Interpolation
+{
+    linear = 0,
+    hermite,
+    lagrange,
+    allpass,
+    sinc
+};
+
+namespace Interpolators
+{
+    struct Linear
+    {
+        static constexpr int numTaps = 2;
+
+        template <typename T>
+        static inline T interpolate(const T* x, T t) noexcept {
+            return x[0] + (x[1] - x[0]) * t;
+        }
+    };
+
+    // 4-point, 3rd-order Hermite (Catmull-Rom)
+    struct Hermite
+    {
+        static constexpr int numTaps = 4;
+
+        template <typename T>
+        static inline T interpolate(const T* x, T t) noexcept {
+            const T c1 = (x[2] - x[0]) * 0.5f;
+            const T c2 = x[0] - x[1] * 2.5f + x[2] * 2.0f - x[3] * 0.5f;
+            const T c3 = (x[3] - x[0]) * 0.5f + (x[1] - x[2]) * 1.5f;
+            return ((c3 * t + c2) * t + c1) * t + x[1];
+        }
+    };
+
+    // 3rd-order Lagrange through the taps at -1, 0, 1 and 2
+    struct Lagrange
+    {
+        static constexpr int numTaps = 4;
+
+        template <typename T>
+        static inline T interpolate(const T* x, T t) noexcept {
+            const T d0 = t + 1.0f;
+            const T d2 = t - 1.0f;
+            const T d3 = t - 2.0f;
+            return x[0] * (t * d2 * d3 * (-1.0f / 6))
+                 + x[1] * (d0 * d2 * d3 * 0.5f)
+                 + x[2] * (d0 * t * d3 * -0.5f)
+                 + x[3] * (d0 * t * d2 * (1.0f / 6));
+        }
+    };
+
+    // First order Thiran allpass. It is recursive, so it runs one sample at a
+    // time with its own state per read head. The fractional part is kept in
+    // 0.618..1.618 where the filter's phase delay is flattest.
+    struct Allpass
+    {
+        static constexpr int numTaps = 2;
+        static constexpr float minFraction = 0.618f;
+
+        // x[0] is one sample older than x[1], fraction is the delay past x[1]
+        static inline float interpolate(const float* x, float fraction, float& state) noexcept {
+            const float a = (1 - fraction) / (1 + fraction);
+            state = a * (x[1] - state) + x[0];
+            return state;
+        }
+    };
+
+    // 8 tap Kaiser windowed sinc with a polyphase coefficient table
+    struct WindowedSinc
+    {
+        static constexpr int numTaps = 8;
+        static constexpr int numPhases = 256;
+
+        static inline float interpolate(const float* x, float t) noexcept {
+            float weights[numTaps];
+            getWeights(t, weights);
+
+            float sum = 0;
+            for (int tap = 0; tap < numTaps; tap++) {
+                sum += x[tap] * weights[tap];
+            }
+            return sum;
+        }
+
+#if JUCE_USE_SIMD
+        // Every lane has its own phase, so the weights are looked up per lane
+        // and the multiply-accumulate runs across lanes
+        using Vec = juce::dsp::SIMDRegister<float>;
+
+        static inline Vec interpolate(const Vec* x, Vec t) noexcept {
+            constexpr int lanes = (int)Vec::SIMDNumElements;
+            alignas(Vec::SIMDRegisterSize) float weights[numTaps][lanes];
+
+            for (int lane = 0; lane < lanes; lane++) {
+                float laneWeights[numTaps];
+                getWeights(t.get((size_t)lane), laneWeights);
+                for (int tap = 0; tap < numTaps; tap++) {
+                    weights[tap][lane] = laneWeights[tap];
+                }
+            }
+
+            Vec sum = x[0] * Vec::fromRawArray(weights[0]);
+            for (int tap = 1; tap < numTaps; tap++) {
+                sum += x[tap] * Vec::fromRawArray(weights[tap]);
+            }
+            return sum;
+        }
+#endif
+
+        // weights for position t (0..1), interpolated between neighbouring phases
+        static inline void getWeights(float t, float* weights) noexcept {
+            const float position = t * numPhases;
+            const int phase = (int)position;
+            const float fraction = position - phase;
+            const float* row = getTable() + phase * numTaps;
+
+            for (int tap = 0; tap < numTaps; tap++) {
+                weights[tap] = row[tap] + fraction * (row[tap + numTaps] - row[tap]);
+            }
+        }
+
+        // numPhases + 2 rows of numTaps weights, shared by all instances
+        static const float* getTable();
+    };
+}
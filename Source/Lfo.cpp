@@ -0,0 +1,127 @@
+/*
+  ==============================================================================
+
+    Lfo.cpp
+
+  ==============================================================================
+*/
+
+#include "Lfo.h"
+
+Lfo::Lfo()
+{
+    mSineTable = getSineTable();
+    mShape = sine;
+    mDoublePrecision = false;
+    reset();
+}
+
+const float* Lfo::getSineTable()
+{
+    // built once on first use, which is always from a constructor
+    static const std::array<float, tableSize + 1> table = [] {
+        std::array<float, tableSize + 1> t;
+        for (int i = 0; i <= tableSize; i++) {
+            t[(size_t)i] = (float)std::sin(juce::MathConstants<double>::twoPi * i / tableSize);
+        }
+        return t;
+    }();
+    return table.data();
+}
+
+void Lfo::reset()
+{
+    mPhase = 0.0;
+    for (auto& point : mRandomPoints) {
+        point = mRandom.nextFloat() * 2 - 1;
+    }
+}
+
+void Lfo::copyStateFrom(const Lfo& other) noexcept
+{
+    mShape = other.mShape;
+    mDoublePrecision = other.mDoublePrecision;
+    mPhase = other.mPhase;
+    std::copy(std::begin(other.mRandomPoints), std::end(other.mRandomPoints), mRandomPoints);
+    mRandom = other.mRandom;
+}
+
+void Lfo::nextRandomTarget() noexcept
+{
+    mRandomPoints[0] = mRandomPoints[1];
+    mRandomPoints[1] = mRandomPoints[2];
+    mRandomPoints[2] = mRandom.nextFloat() * 2 - 1;
+}
+
+inline float Lfo::renderSample(float phase) const noexcept
+{
+    // phase is in 0..2, anything past 1 belongs to the next cycle
+    switch (mShape) {
+    case triangle: {
+        // starts at 0 and rises, like the sine
+        float shifted = phase + 0.25f;
+        shifted -= (int)shifted;
+        return 1 - 4 * std::abs(shifted - 0.5f);
+    }
+    case random: {
+        const int cycle = phase >= 1 ? 1 : 0;
+        const float t = phase - cycle;
+        // smoothstep between this cycle's point and the next
+        const float smoothed = t * t * (3 - 2 * t);
+        return mRandomPoints[cycle] + smoothed * (mRandomPoints[cycle + 1] - mRandomPoints[cycle]);
+    }
+    default: {
+        float wrapped = phase - (int)phase;
+        const float position = wrapped * tableSize;
+        const int index = (int)position;
+        const float fraction = position - index;
+        return mSineTable[index] + fraction * (mSineTable[index + 1] - mSineTable[index]);
+    }
+    }
+}
+
+template <typename Phase, typename Increments>
+void Lfo::run(float* const* outputs, const float* phaseOffsets, int numOutputs, int numSamples,
+    Increments increments) noexcept
+{
+    Phase phase = (Phase)mPhase;
+
+    for (int sample = 0; sample < numSamples; sample++) {
+        for (int output = 0; output < numOutputs; output++) {
+            outputs[output][sample] = renderSample((float)(phase + phaseOffsets[output]));
+        }
+
+        // iterate phase, wrapping between 0 and 1
+        phase += increments(sample);
+        if (phase >= 1) {
+            phase -= 1;
+            nextRandomTarget();
+        }
+    }
+
+    mPhase = phase;
+}
+
+void Lfo::process(float* const* outputs, const float* phaseOffsets, int numOutputs, int numSamples,
+    float phaseIncrement) noexcept
+{
+    const auto increments = [phaseIncrement](int) { return phaseIncrement; };
+    if (mDoublePrecision) {
+        run<double>(outputs, phaseOffsets, numOutputs, numSamples, increments);
+    }
+    else {
+        run<float>(outputs, phaseOffsets, numOutputs, numSamples, increments);
+    }
+}
+
+void Lfo::process(float* const* outputs, const float* phaseOffsets, int numOutputs, int numSamples,
+    const float* phaseIncrements) noexcept
+{
+    const auto increments = [phaseIncrements](int sample) { return phaseIncrements[sample]; };
+    if (mDoublePrecision) {
+        run<double>(outputs, phaseOffsets, numOutputs, numSamples, increments);
+    }
+    else {
+        run<float>(outputs, phaseOffsets, numOutputs, numSamples, increments);
+    }
+}
@@ -0,0 +1,86 @@
+/*
+  ==============================================================================
+
+    Lfo.h
+
+    Phase-accumulator LFO with selectable shapes. Sine comes from a shared
+    wavetable, so neither the main output nor the phase-offset outputs
+    need a transcendental call.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+
+//==============================================================================
+/**
+*/
+class Lfo
+{
+public:
+    enum Shape
+    {
+        sine = 0,
+        triangle,
+        random,
+        numShapes
+    };
+
+    Lfo();
+
+    void reset();
+    void setShape(int newShape) noexcept { mShape = juce::jlimit(0, numShapes - 1, newShape); }
+
+    // The random shape's points come from this seed from the next reset() on,
+    // rather than from a randomly seeded generator
+    void setSeed(juce::int64 seed) noexcept { mRandom.setSeed(seed); }
+
+    // Accumulates the phase in double rather than float. Float is exact enough
+    // for a block or two, but over minutes its rounding adds up to an audible
+    // rate error at slow rates.
+    void setDoublePrecision(bool shouldUseDouble) noexcept { mDoublePrecision = shouldUseDouble; }
+
+    // Picks up where another LFO is, shape, precision, phase and random points, so the two run on identically
+    void copyStateFrom(const Lfo& other) noexcept;
+
+    // Fills numOutputs buffers with numSamples of bipolar (-1..1) output. Output i
+    // runs phaseOffsets[i] cycles (0..1) ahead of the shared phase, which then
+    // advances by phaseIncrement cycles per sample.
+    void process(float* const* outputs, const float* phaseOffsets, int numOutputs, int numSamples,
+        float phaseIncrement) noexcept;
+
+    // As above, with a separate increment for every sample so rate changes can glide
+    void process(float* const* outputs, const float* phaseOffsets, int numOutputs, int numSamples,
+        const float* phaseIncrements) noexcept;
+
+    float getPhase() const noexcept { return (float)mPhase; }
+
+private:
+    static constexpr int tableSize = 1024;
+
+    // one cycle of sine plus a guard point for interpolation, shared by all instances
+    static const float* getSineTable();
+
+    inline float renderSample(float phase) const noexcept;
+    void nextRandomTarget() noexcept;
+
+    // the shared loop of both process() calls, Phase is what the phase accumulates in
+    template <typename Phase, typename Increments>
+    void run(float* const* outputs, const float* phaseOffsets, int numOutputs, int numSamples,
+        Increments increments) noexcept;
+
+    const float* mSineTable;
+    int mShape;
+    // kept as double, a float phase round trips through it exactly
+    double mPhase;
+    bool mDoublePrecision;
+
+    // smoothed random glides between consecutive points, one per cycle.
+    // Offset outputs may be up to a cycle ahead, so three points are kept.
+    float mRandomPoints[3];
+    juce::Random mRandom;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Lfo)
+};
@@ -0,0 +1,247 @@
+/*
+  ==============================================================================
+
+    MultiTap.cpp
+
+  ==============================================================================
+*/
+
+#include "MultiTap.h"
+
+// a moved tap fades over the same time as delay mode's crossfade
+static const double fadeTime = 0.05;
+
+MultiTap::MultiTap()
+{
+    for (int i = 0; i < maxTaps; i++) {
+        mTaps[i] = { 1.0f, 1.0f, 1.0f, 0, false, true, 0.0f, 0.0f, 0.0f, 1.0f };
+        mOrder[i] = i;
+    }
+    mOrderChanged = false;
+    mNumTaps = 1;
+    mFadeLength = (int)std::ceil(fadeTime * 44100.0);
+    mNumChannels = 0;
+    mLeftChannel = -1;
+    mRightChannel = -1;
+    mToneStateChannels = 0;
+    mSampleRate = 44100.0;
+}
+
+void MultiTap::prepare(int numChannels, double sampleRate)
+{
+    mNumChannels = numChannels;
+    mSampleRate = sampleRate;
+    mFadeLength = (int)std::ceil(fadeTime * sampleRate);
+
+    // the state is only reallocated for more channels than it has room for
+    if (numChannels > mToneStateChannels) {
+        mToneState.allocate((size_t)(maxTaps * numChannels), true);
+        mToneStateChannels = numChannels;
+    }
+    else {
+        reset();
+    }
+
+    // the coefficients depend on the sample rate
+    for (auto& tap : mTaps) {
+        tap.tone = 0.0f;
+        tap.jump = true;
+    }
+}
+
+void MultiTap::reset() noexcept
+{
+    juce::FloatVectorOperations::clear(mToneState.get(), maxTaps * mNumChannels);
+    for (auto& tap : mTaps) {
+        tap.jump = true;
+    }
+}
+
+void MultiTap::setPanChannels(int leftChannel, int rightChannel) noexcept
+{
+    mLeftChannel = leftChannel;
+    mRightChannel = rightChannel;
+}
+
+void MultiTap::setNumTaps(int numTaps) noexcept
+{
+    numTaps = juce::jlimit(1, maxTaps, numTaps);
+    if (numTaps != mNumTaps) {
+        for (int i = mNumTaps; i < numTaps; i++) {
+            mTaps[i].jump = true;
+        }
+        mNumTaps = numTaps;
+        mOrderChanged = true;
+    }
+}
+
+void MultiTap::setTap(int index, float delayInSamples, float gain, float pan, float toneHz) noexcept
+{
+    jassert(juce::isPositiveAndBelow(index, maxTaps));
+    Tap& tap = mTaps[index];
+
+    tap.nextDelay = delayInSamples;
+    if (tap.jump) {
+        tap.delay = delayInSamples;
+        tap.fadeDelay = delayInSamples;
+        tap.fadeSamples = 0;
+        tap.fading = false;
+        tap.jump = false;
+        mOrderChanged = true;
+    }
+    else if (! tap.fading && ! juce::exactlyEqual(delayInSamples, tap.delay)) {
+        startFade(tap);
+    }
+    tap.gain = gain;
+    tap.pan = pan;
+
+    // one-pole lowpass, only recalculated when the cutoff moves
+    if (! juce::exactlyEqual(toneHz, tap.tone)) {
+        tap.tone = toneHz;
+        tap.toneCoefficient = 1 - std::exp(-juce::MathConstants<float>::twoPi * toneHz / (float)mSampleRate);
+    }
+}
+
+void MultiTap::startFade(Tap& tap) noexcept
+{
+    tap.fadeDelay = tap.nextDelay;
+    tap.fadeSamples = 0;
+    tap.fading = true;
+}
+
+float MultiTap::getShortestDelay() const noexcept
+{
+    float shortest = juce::jmin(mTaps[0].delay, mTaps[0].fadeDelay);
+    for (int i = 1; i < mNumTaps; i++) {
+        shortest = juce::jmin(shortest, mTaps[i].delay, mTaps[i].fadeDelay);
+    }
+    return shortest;
+}
+
+float MultiTap::getLongestDelay() const noexcept
+{
+    float longest = juce::jmax(mTaps[0].delay, mTaps[0].fadeDelay);
+    for (int i = 1; i < mNumTaps; i++) {
+        longest = juce::jmax(longest, mTaps[i].delay, mTaps[i].fadeDelay);
+    }
+    return longest;
+}
+
+int MultiTap::getFadeSamplesLeft() const noexcept
+{
+    int left = maxFade;
+    for (int i = 0; i < mNumTaps; i++) {
+        if (mTaps[i].fading) {
+            left = juce::jmin(left, mFadeLength - mTaps[i].fadeSamples);
+        }
+    }
+    return left;
+}
+
+void MultiTap::advance(int numSamples) noexcept
+{
+    for (int i = 0; i < mNumTaps; i++) {
+        Tap& tap = mTaps[i];
+        if (! tap.fading) {
+            continue;
+        }
+
+        // the new read takes over, and a setting that came in meanwhile fades in next
+        tap.fadeSamples += numSamples;
+        if (tap.fadeSamples >= mFadeLength) {
+            tap.delay = tap.fadeDelay;
+            tap.fadeSamples = 0;
+            tap.fading = false;
+            mOrderChanged = true;
+            if (! juce::exactlyEqual(tap.nextDelay, tap.delay)) {
+                startFade(tap);
+            }
+        }
+    }
+}
+
+void MultiTap::sortTaps() noexcept
+{
+    // insertion sort, there are never more than 16 and they are usually in order already
+    for (int i = 0; i < mNumTaps; i++) {
+        mOrder[i] = i;
+    }
+    for (int i = 1; i < mNumTaps; i++) {
+        const int index = mOrder[i];
+        int j = i;
+        for (; j > 0 && mTaps[mOrder[j - 1]].delay > mTaps[index].delay; j--) {
+            mOrder[j] = mOrder[j - 1];
+        }
+        mOrder[j] = index;
+    }
+    mOrderChanged = false;
+}
+
+float MultiTap::getPanGain(const Tap& tap, int channel) const noexcept
+{
+    // centre, LFE, surrounds and ambisonic components aren't panned into
+    if (mLeftChannel < 0 || mRightChannel < 0 || (channel != mLeftChannel && channel != mRightChannel)) {
+        return 1.0f;
+    }
+
+    // equal power between left and right
+    const float position = (tap.pan + 1) * 0.5f;
+    const float distance = channel == mLeftChannel ? position : 1 - position;
+    return std::cos(distance * juce::MathConstants<float>::halfPi);
+}
+
+// tap times hold for the chunk, so whole-sample ones are a plain copy
+static void readTap(const DelayLine& delayLine, Interpolation kernel, int channel, float delay, float* delayScratch,
+    float* output, int numSamples) noexcept
+{
+    if (juce::exactlyEqual(delay, (float)(int)delay)) {
+        delayLine.readInteger(channel, (int)delay, output, numSamples);
+    }
+    else {
+        float allpassState = 0.0f;
+        juce::FloatVectorOperations::fill(delayScratch, delay, numSamples);
+        delayLine.read(kernel, channel, delayScratch, output, numSamples, allpassState);
+    }
+}
+
+void MultiTap::process(const DelayLine& delayLine, Interpolation kernel, int channel, float* wet, float* feedback,
+    float* delayScratch, float* tapScratch, float* fadeScratch, int numSamples) noexcept
+{
+    if (mOrderChanged) {
+        sortTaps();
+    }
+
+    juce::FloatVectorOperations::clear(wet, numSamples);
+    float* toneState = mToneState.get() + channel * maxTaps;
+
+    for (int i = 0; i < mNumTaps; i++) {
+        const int index = mOrder[i];
+        const Tap& tap = mTaps[index];
+
+        // the longest tap is read straight into the feedback buffer
+        float* output = i == mNumTaps - 1 ? feedback : tapScratch;
+
+        readTap(delayLine, kernel, channel, tap.delay, delayScratch, output, numSamples);
+
+        // linear fade from the old read to the new one
+        if (tap.fading) {
+            readTap(delayLine, kernel, channel, tap.fadeDelay, delayScratch, fadeScratch, numSamples);
+            for (int sample = 0; sample < numSamples; sample++) {
+                const float gain = (float)(tap.fadeSamples + sample + 1) / (float)mFadeLength;
+                output[sample] += gain * (fadeScratch[sample] - output[sample]);
+            }
+        }
+
+        float state = toneState[index];
+        for (int sample = 0; sample < numSamples; sample++) {
+            state += tap.toneCoefficient * (output[sample] - state);
+            output[sample] = state;
+        }
+        toneState[index] = state;
+
+        const float gain = tap.gain * getPanGain(tap, channel);
+        if (! juce::exactlyEqual(gain, 0.0f)) {
+            juce::FloatVectorOperations::addWithMultiply(wet, output, gain, numSamples);
+        }
+    }
+}
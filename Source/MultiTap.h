@@ -0,0 +1,103 @@
+/*
+  ==============================================================================
+
+    MultiTap.h
+
+    Up to maxTaps read heads on one DelayLine, each with its own time, gain,
+    pan and lowpass tone. Taps are swept in order of increasing delay so the
+    reads walk through the ring in one direction instead of jumping around.
+    A tap whose time changes crossfades from its old read to the new one.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+#include "DelayLine.h"
+
+//==============================================================================
+/**
+*/
+class MultiTap
+{
+public:
+    static constexpr int maxTaps = 16;
+
+    MultiTap();
+
+    // Sizes the filter state, call from prepareToPlay
+    void prepare(int numChannels, double sampleRate);
+
+    // Clears the filter state. The next delay each tap is set to is jumped to
+    // rather than faded to, so call it when the ring is cleared or the mode starts.
+    void reset() noexcept;
+
+    // The pair the taps are panned between, -1 when the layout has no left and right.
+    // Every other channel, and every channel without a pair, gets the taps at unity.
+    void setPanChannels(int leftChannel, int rightChannel) noexcept;
+
+    // Tap settings, picked up by the next process(). Delay in samples, linear gain,
+    // pan from -1 (left) to 1 (right) and the lowpass cutoff in Hz.
+    // A new delay fades in once any fade the tap is already in has finished.
+    void setNumTaps(int numTaps) noexcept;
+    void setTap(int index, float delayInSamples, float gain, float pan, float toneHz) noexcept;
+
+    int getNumTaps() const noexcept { return mNumTaps; }
+    // both the old and the new read of a fading tap count
+    float getShortestDelay() const noexcept;
+    float getLongestDelay() const noexcept;
+    // samples until the first running fade ends, or maxFade when none runs
+    int getFadeSamplesLeft() const noexcept;
+
+    // Adds every tap of one channel into wet (which is cleared first). The longest
+    // tap, filtered but before gain and pan, also goes to feedback.
+    // delayScratch, tapScratch and fadeScratch are numSamples of working space each.
+    void process(const DelayLine& delayLine, Interpolation kernel, int channel, float* wet, float* feedback,
+        float* delayScratch, float* tapScratch, float* fadeScratch, int numSamples) noexcept;
+
+    // Moves the fades on, call once after every channel's process()
+    void advance(int numSamples) noexcept;
+
+    static constexpr int maxFade = 1 << 30;
+
+private:
+    // delay is where the tap reads, fadeDelay where it is fading to while fading
+    // (equal otherwise) and nextDelay the newest setting, waiting for the fade to end.
+    // A tap that hasn't been heard yet jumps to its first setting.
+    struct Tap
+    {
+        float delay;
+        float fadeDelay;
+        float nextDelay;
+        int fadeSamples;
+        bool fading;
+        bool jump;
+        float gain;
+        float pan;
+        float tone;
+        float toneCoefficient;
+    };
+
+    void sortTaps() noexcept;
+    void startFade(Tap& tap) noexcept;
+    float getPanGain(const Tap& tap, int channel) const noexcept;
+
+    Tap mTaps[maxTaps];
+    // tap indices by increasing delay
+    int mOrder[maxTaps];
+    bool mOrderChanged;
+    int mNumTaps;
+    int mFadeLength;
+
+    int mNumChannels;
+    int mLeftChannel;
+    int mRightChannel;
+    double mSampleRate;
+
+    // one lowpass state per tap and channel, with room for mToneStateChannels
+    juce::HeapBlock<float> mToneState;
+    int mToneStateChannels;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MultiTap)
+};
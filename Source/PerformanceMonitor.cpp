@@ -0,0 +1,175 @@
+/*
+  ==============================================================================
+
+    PerformanceMonitor.cpp
+
+  ==============================================================================
+*/
+
+#include "PerformanceMonitor.h"
+
+PerformanceMonitor::PerformanceMonitor()
+    : mCreationTicks(juce::Time::getHighResolutionTicks()),
+      mSecondsPerTick(1.0 / (double)juce::Time::getHighResolutionTicksPerSecond()),
+      mFifo(fifoSize)
+{
+    mSampleRate = 44100.0;
+    mHistory.resize(historySize);
+    mHistoryStart = 0;
+    mHistoryCount = 0;
+    mResetPending = false;
+    clearTotals();
+}
+
+void PerformanceMonitor::prepare(double sampleRate) noexcept
+{
+    mSampleRate = sampleRate;
+}
+
+PerformanceMonitor::ScopedBlock::ScopedBlock(PerformanceMonitor& monitor, int numSamples) noexcept
+    : mMonitor(monitor)
+{
+    mStartTicks = juce::Time::getHighResolutionTicks();
+    mNumSamples = numSamples;
+}
+
+PerformanceMonitor::ScopedBlock::~ScopedBlock() noexcept
+{
+    mMonitor.addBlock(mStartTicks, juce::Time::getHighResolutionTicks(), mNumSamples, type, oversampling, silent);
+}
+
+void PerformanceMonitor::addBlock(juce::int64 startTicks, juce::int64 endTicks, int numSamples, int type,
+    int oversampling, bool silent) noexcept
+{
+    if (numSamples <= 0) {
+        return;
+    }
+
+    if (mResetPending.exchange(false)) {
+        clearTotals();
+    }
+
+    // how long the block took against how long it lasts
+    const juce::int64 busyTicks = endTicks - startTicks;
+    const double budget = numSamples / mSampleRate.load();
+    const float microseconds = (float)(busyTicks * mSecondsPerTick * 1.0e6);
+    const float load = (float)(busyTicks * mSecondsPerTick / budget);
+
+    // only this thread writes these, so plain loads and stores are enough
+    mBusyTicks.store(mBusyTicks.load(std::memory_order_relaxed) + busyTicks, std::memory_order_relaxed);
+    mBudgetTicks.store(mBudgetTicks.load(std::memory_order_relaxed) + (juce::int64)(budget / mSecondsPerTick),
+        std::memory_order_relaxed);
+    mNumBlocks.store(mNumBlocks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    mNumSamples.store(mNumSamples.load(std::memory_order_relaxed) + numSamples, std::memory_order_relaxed);
+    if (load > mPeakLoad.load(std::memory_order_relaxed)) {
+        mPeakLoad.store(load, std::memory_order_relaxed);
+    }
+    if (microseconds > mWorstMicroseconds.load(std::memory_order_relaxed)) {
+        mWorstMicroseconds.store(microseconds, std::memory_order_relaxed);
+    }
+    if (load > riskLoad) {
+        mNumRiskyBlocks.store(mNumRiskyBlocks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    if (load > 1.0f) {
+        mNumOverruns.store(mNumOverruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // With nobody collecting, e.g. the editor closed, the FIFO fills and the
+    // records are dropped. The totals above still count them.
+    const auto scope = mFifo.write(1);
+    if (scope.blockSize1 + scope.blockSize2 == 0) {
+        mNumDropped.store(mNumDropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+
+    BlockRecord& record = mFifoRecords[scope.blockSize1 > 0 ? scope.startIndex1 : scope.startIndex2];
+    record.time = (endTicks - mCreationTicks) * mSecondsPerTick;
+    record.microseconds = microseconds;
+    record.load = load;
+    record.numSamples = numSamples;
+    record.type = type;
+    record.oversampling = oversampling;
+    record.silent = silent;
+}
+
+int PerformanceMonitor::collect()
+{
+    const auto scope = mFifo.read(mFifo.getNumReady());
+    const int numRead = scope.blockSize1 + scope.blockSize2;
+
+    scope.forEach([this](int index) {
+        mHistory[(size_t)((mHistoryStart + mHistoryCount) % historySize)] = mFifoRecords[index];
+        if (mHistoryCount < historySize) {
+            mHistoryCount++;
+        }
+        else {
+            mHistoryStart = (mHistoryStart + 1) % historySize;
+        }
+    });
+
+    return numRead;
+}
+
+PerformanceMonitor::Summary PerformanceMonitor::getSummary() const noexcept
+{
+    Summary summary {};
+    if (mResetPending) {
+        return summary;
+    }
+
+    const juce::int64 budgetTicks = mBudgetTicks.load(std::memory_order_relaxed);
+    summary.averageLoad = budgetTicks > 0 ? (double)mBusyTicks.load(std::memory_order_relaxed) / budgetTicks : 0.0;
+    summary.peakLoad = mPeakLoad.load(std::memory_order_relaxed);
+    summary.worstMicroseconds = mWorstMicroseconds.load(std::memory_order_relaxed);
+    summary.numBlocks = mNumBlocks.load(std::memory_order_relaxed);
+    summary.numSamples = mNumSamples.load(std::memory_order_relaxed);
+    summary.numRiskyBlocks = mNumRiskyBlocks.load(std::memory_order_relaxed);
+    summary.numOverruns = mNumOverruns.load(std::memory_order_relaxed);
+    summary.numDropped = mNumDropped.load(std::memory_order_relaxed);
+    return summary;
+}
+
+void PerformanceMonitor::reset() noexcept
+{
+    // the totals have a single writer, so the audio thread clears them itself
+    mResetPending = true;
+
+    // anything still in the FIFO belongs to before the reset
+    mFifo.read(mFifo.getNumReady());
+    mHistoryStart = 0;
+    mHistoryCount = 0;
+}
+
+void PerformanceMonitor::clearTotals() noexcept
+{
+    mBusyTicks = 0;
+    mBudgetTicks = 0;
+    mPeakLoad = 0.0f;
+    mWorstMicroseconds = 0.0f;
+    mNumBlocks = 0;
+    mNumSamples = 0;
+    mNumRiskyBlocks = 0;
+    mNumOverruns = 0;
+    mNumDropped = 0;
+}
+
+bool PerformanceMonitor::writeCsv(const juce::File& file) const
+{
+    juce::FileOutputStream stream(file);
+    if (! stream.openedOk()) {
+        return false;
+    }
+    stream.setPosition(0);
+    stream.truncate();
+
+    stream << "time_s,microseconds,load,samples,type,oversampling,silent\n";
+    for (int i = 0; i < mHistoryCount; i++) {
+        const BlockRecord& record = mHistory[(size_t)((mHistoryStart + i) % historySize)];
+        stream << juce::String(record.time, 6) << "," << juce::String(record.microseconds, 2) << ","
+            << juce::String(record.load, 4) << "," << record.numSamples << "," << record.type << ","
+            << record.oversampling << "," << (record.silent ? 1 : 0) << "\n";
+    }
+
+    stream.flush();
+    return stream.getStatus().wasOk();
+}
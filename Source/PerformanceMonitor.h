@@ -0,0 +1,130 @@
+/*
+  ==============================================================================
+
+    PerformanceMonitor.h
+
+    Per-block timing of processBlock. The audio thread pushes one record per
+    block into a lock-free FIFO and keeps a few atomic totals and high-water
+    marks; the message thread drains the FIFO into a history it can show or
+    write out as CSV. Nothing on the audio side locks or allocates.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+*/
+class PerformanceMonitor
+{
+public:
+    // blocks that fit in the FIFO between two collect() calls
+    static constexpr int fifoSize = 1024;
+    // blocks kept on the message thread for writeCsv()
+    static constexpr int historySize = 8192;
+
+    // a block that used more than this much of its own duration risks an xrun
+    static constexpr float riskLoad = 0.5f;
+
+    struct BlockRecord
+    {
+        double time;        // seconds since the monitor was created, at the end of the block
+        float microseconds; // time spent in processBlock
+        float load;         // microseconds over the block's duration
+        int numSamples;
+        int type;
+        int oversampling;   // 1, 2 or 4
+        bool silent;        // the engine was skipped
+    };
+
+    struct Summary
+    {
+        double averageLoad;
+        float peakLoad;
+        float worstMicroseconds;
+        juce::int64 numBlocks;
+        juce::int64 numSamples;
+        juce::int64 numRiskyBlocks;
+        juce::int64 numOverruns;
+        juce::int64 numDropped;
+    };
+
+    PerformanceMonitor();
+
+    // Call from prepareToPlay
+    void prepare(double sampleRate) noexcept;
+
+    //==============================================================================
+    /**
+        Put one of these at the top of processBlock, after the allocation guard.
+        It times everything up to the end of its scope and fills in the rest of
+        the record as processBlock learns it.
+    */
+    class ScopedBlock
+    {
+    public:
+        ScopedBlock(PerformanceMonitor& monitor, int numSamples) noexcept;
+        ~ScopedBlock() noexcept;
+
+        int type = 0;
+        int oversampling = 1;
+        bool silent = false;
+
+    private:
+        PerformanceMonitor& mMonitor;
+        juce::int64 mStartTicks;
+        int mNumSamples;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedBlock)
+    };
+
+    //==============================================================================
+    // Message thread only. Moves what the audio thread has pushed into the
+    // history and returns how many records came in.
+    int collect();
+
+    // Totals and high-water marks, safe from any thread
+    Summary getSummary() const noexcept;
+
+    // Starts the totals, peaks and history again, message thread only
+    void reset() noexcept;
+
+    // Writes the history, oldest block first. Message thread only.
+    bool writeCsv(const juce::File& file) const;
+
+private:
+    void addBlock(juce::int64 startTicks, juce::int64 endTicks, int numSamples, int type, int oversampling,
+        bool silent) noexcept;
+    void clearTotals() noexcept;
+
+    std::atomic<double> mSampleRate;
+    const juce::int64 mCreationTicks;
+    const double mSecondsPerTick;
+
+    // audio thread to message thread
+    juce::AbstractFifo mFifo;
+    BlockRecord mFifoRecords[fifoSize];
+
+    // Written by the audio thread only, the peaks only ever go up. reset() asks
+    // for them to be cleared at the start of the next block.
+    std::atomic<bool> mResetPending;
+    std::atomic<juce::int64> mBusyTicks;
+    std::atomic<juce::int64> mBudgetTicks;
+    std::atomic<float> mPeakLoad;
+    std::atomic<float> mWorstMicroseconds;
+    std::atomic<juce::int64> mNumBlocks;
+    std::atomic<juce::int64> mNumSamples;
+    std::atomic<juce::int64> mNumRiskyBlocks;
+    std::atomic<juce::int64> mNumOverruns;
+    std::atomic<juce::int64> mNumDropped;
+
+    // message thread, a ring of the latest historySize records
+    std::vector<BlockRecord> mHistory;
+    int mHistoryStart;
+    int mHistoryCount;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PerformanceMonitor)
+};
@@ -12,77 +12,328 @@
 
 //==============================================================================
 TelayAudioProcessorEditor::TelayAudioProcessorEditor(TelayAudioProcessor& p, juce::AudioProcessorValueTreeState& vts)
-    : AudioProcessorEditor(&p), audioProcessor(p), valueTreeState(vts)
+    : AudioProcessorEditor(&p), audioProcessor(p), valueTreeState(vts), mSignalView(p.getSignalMonitor())
 {
-    // Make sure that before the constructor has finished, you've set the
-    // editor's size to whatever you need it to be.
-    setSize(WINDOW_WIDTH, WINDOW_HEIGHT);
-    int comY = WINDOW_HEIGHT / 4;
-    int comWFactor = WINDOW_WIDTH / 3.5;
-    int comWidth = WINDOW_WIDTH / 4;
-    int comHeight = WINDOW_HEIGHT / 4;
-
     // DryWet
-    createLabelAndSlider(&mDryWetLabel, "Dry/Wet", &mDryWetSlider,
-        .25* comWFactor, comY, comWidth, comHeight);
+    createLabelAndSlider(&mDryWetLabel, "Dry/Wet", &mDryWetSlider);
     mDryWetAttach.reset(new juce::AudioProcessorValueTreeState::SliderAttachment(vts, "DryWet", mDryWetSlider));
 
     // Feedback
-    createLabelAndSlider(&mFeedbackLabel, "Feedback", &mFeedbackSlider,
-        1.25* comWFactor, comY, comWidth, comHeight);
+    createLabelAndSlider(&mFeedbackLabel, "Feedback", &mFeedbackSlider);
     mFeedbackAttach.reset(new juce::AudioProcessorValueTreeState::SliderAttachment(vts, "Feedback", mFeedbackSlider));
 
     // Depth
-    createLabelAndSlider(&mDepthLabel, "Depth", &mDepthSlider,
-        .25* comWFactor, comY*2.5, comWidth, comHeight);
+    createLabelAndSlider(&mDepthLabel, "Depth", &mDepthSlider);
     mDepthAttach.reset(new juce::AudioProcessorValueTreeState::SliderAttachment(vts, "Depth", mDepthSlider));
 
     // Rate
-    createLabelAndSlider(&mRateLabel, "Rate", &mRateSlider,
-        1.25*comWFactor, comY*2.5, comWidth, comHeight);
+    createLabelAndSlider(&mRateLabel, "Rate", &mRateSlider);
     mRateAttach.reset(new juce::AudioProcessorValueTreeState::SliderAttachment(vts, "Rate", mRateSlider));
 
     // PhaseOffset
-    createLabelAndSlider(&mPhaseOffsetLabel, "PhaseOffset", &mPhaseOffsetSlider,
-        2.25* comWFactor, comY*2.5, comWidth, comHeight);
+    createLabelAndSlider(&mPhaseOffsetLabel, "PhaseOffset", &mPhaseOffsetSlider);
     mPhaseOffsetAttach.reset(new juce::AudioProcessorValueTreeState::SliderAttachment(vts, "PhaseOffset", mPhaseOffsetSlider));
 
     addAndMakeVisible(&mTypeLabel);
     mTypeLabel.setText("Effect Type", juce::NotificationType::dontSendNotification);
     mTypeLabel.attachToComponent(&mType, false);
 
-    mType.addItem("Delay", 1);
-    mType.addItem("Chorus", 2);
-    mType.addItem("Flanger", 3);
-
-    mType.setBounds(.25*comWFactor, comY/3, comWidth, 30);
+    for (int type = 0; type < TelayAudioProcessor::numEffectTypes; type++) {
+        mType.addItem(TelayAudioProcessor::getTypeName(type), type + 1);
+    }
 
     addAndMakeVisible(mType);
     mTypeAttach.reset(new juce::AudioProcessorValueTreeState::ComboBoxAttachment(vts, "Type", mType));
+
+    addAndMakeVisible(&mShapeLabel);
+    mShapeLabel.setText("LFO Shape", juce::NotificationType::dontSendNotification);
+    mShapeLabel.attachToComponent(&mShape, false);
+
+    mShape.addItem("Sine", 1);
+    mShape.addItem("Triangle", 2);
+    mShape.addItem("Random", 3);
+
+    addAndMakeVisible(mShape);
+    mShapeAttach.reset(new juce::AudioProcessorValueTreeState::ComboBoxAttachment(vts, "Shape", mShape));
+
+    addAndMakeVisible(&mQualityLabel);
+    mQualityLabel.setText("Quality", juce::NotificationType::dontSendNotification);
+    mQualityLabel.attachToComponent(&mQuality, false);
+
+    mQuality.addItem("Draft", 1);
+    mQuality.addItem("Standard", 2);
+    mQuality.addItem("High", 3);
+
+    addAndMakeVisible(mQuality);
+    mQualityAttach.reset(new juce::AudioProcessorValueTreeState::ComboBoxAttachment(vts, "Quality", mQuality));
+
+    addAndMakeVisible(&mTimeModeLabel);
+    mTimeModeLabel.setText("Time Change", juce::NotificationType::dontSendNotification);
+    mTimeModeLabel.attachToComponent(&mTimeMode, false);
+
+    mTimeMode.addItem("Glide", 1);
+    mTimeMode.addItem("Crossfade", 2);
+
+    addAndMakeVisible(mTimeMode);
+    mTimeModeAttach.reset(new juce::AudioProcessorValueTreeState::ComboBoxAttachment(vts, "TimeMode", mTimeMode));
+
+    addAndMakeVisible(&mOversamplingLabel);
+    mOversamplingLabel.setText("Oversampling", juce::NotificationType::dontSendNotification);
+    mOversamplingLabel.attachToComponent(&mOversampling, false);
+
+    mOversampling.addItem("1x", 1);
+    mOversampling.addItem("2x", 2);
+    mOversampling.addItem("4x", 3);
+
+    addAndMakeVisible(mOversampling);
+    mOversamplingAttach.reset(new juce::AudioProcessorValueTreeState::ComboBoxAttachment(vts, "Oversampling", mOversampling));
+
+    // Note division for the tempo synced modes
+    addAndMakeVisible(&mDivisionLabel);
+    mDivisionLabel.setText("Division", juce::NotificationType::dontSendNotification);
+    mDivisionLabel.attachToComponent(&mDivision, false);
+
+    const char* notes[] = { "1/1", "1/2", "1/4", "1/8", "1/16", "1/32" };
+    int divisionId = 1;
+    for (auto* note : notes) {
+        mDivision.addItem(note, divisionId++);
+        mDivision.addItem(juce::String(note) + " Dotted", divisionId++);
+        mDivision.addItem(juce::String(note) + " Triplet", divisionId++);
+    }
+
+    addAndMakeVisible(mDivision);
+    mDivisionAttach.reset(new juce::AudioProcessorValueTreeState::ComboBoxAttachment(vts, "Division", mDivision));
+
+    // Multi-tap row
+    createLabelAndSlider(&mNumTapsLabel, "Taps", &mNumTapsSlider);
+    mNumTapsAttach.reset(new juce::AudioProcessorValueTreeState::SliderAttachment(vts, "Taps", mNumTapsSlider));
+
+    addAndMakeVisible(&mTapSelectLabel);
+    mTapSelectLabel.setText("Edit Tap", juce::NotificationType::dontSendNotification);
+    mTapSelectLabel.attachToComponent(&mTapSelect, false);
+
+    for (int tap = 1; tap <= MultiTap::maxTaps; tap++) {
+        mTapSelect.addItem(juce::String(tap), tap);
+    }
+    mTapSelect.onChange = [this] { attachTapControls(mTapSelect.getSelectedId() - 1); };
+
+    addAndMakeVisible(mTapSelect);
+
+    createLabelAndSlider(&mTapTimeLabel, "Time", &mTapTimeSlider);
+    createLabelAndSlider(&mTapGainLabel, "Gain", &mTapGainSlider);
+    createLabelAndSlider(&mTapPanLabel, "Pan", &mTapPanSlider);
+    createLabelAndSlider(&mTapToneLabel, "Tone", &mTapToneSlider);
+
+    mTapSelect.setSelectedId(1, juce::dontSendNotification);
+    attachTapControls(0);
+
+    // Max delay, in seconds, under the taps
+    addAndMakeVisible(&mMaxDelayLabel);
+    mMaxDelayLabel.setText("Max Delay", juce::dontSendNotification);
+    mMaxDelayLabel.attachToComponent(&mMaxDelaySlider, true);
+
+    addAndMakeVisible(mMaxDelaySlider);
+    mMaxDelaySlider.setSliderStyle(juce::Slider::SliderStyle::LinearHorizontal);
+    mMaxDelaySlider.setTextBoxStyle(juce::Slider::TextBoxRight, true, 50, 30);
+    mMaxDelaySlider.setTextValueSuffix(" s");
+    mMaxDelayAttach.reset(new juce::AudioProcessorValueTreeState::SliderAttachment(vts, "MaxDelay", mMaxDelaySlider));
+
+    // Feedback loop row, under the max delay
+    createLabelAndSlider(&mLowCutLabel, "Low Cut", &mLowCutSlider);
+    mLowCutSlider.setTextValueSuffix(" Hz");
+    mLowCutAttach.reset(new juce::AudioProcessorValueTreeState::SliderAttachment(vts, "LowCut", mLowCutSlider));
+
+    createLabelAndSlider(&mHighCutLabel, "High Cut", &mHighCutSlider);
+    mHighCutSlider.setTextValueSuffix(" Hz");
+    mHighCutAttach.reset(new juce::AudioProcessorValueTreeState::SliderAttachment(vts, "HighCut", mHighCutSlider));
+
+    createLabelAndSlider(&mDriveLabel, "Drive", &mDriveSlider);
+    mDriveAttach.reset(new juce::AudioProcessorValueTreeState::SliderAttachment(vts, "Drive", mDriveSlider));
+
+    createLabelAndSlider(&mWowFlutterLabel, "Wow/Flutter", &mWowFlutterSlider);
+    mWowFlutterAttach.reset(new juce::AudioProcessorValueTreeState::SliderAttachment(vts, "WowFlutter", mWowFlutterSlider));
+
+    // Chorus voices, at the end of the same row
+    createLabelAndSlider(&mNumVoicesLabel, "Voices", &mNumVoicesSlider);
+    mNumVoicesAttach.reset(new juce::AudioProcessorValueTreeState::SliderAttachment(vts, "Voices", mNumVoicesSlider));
+
+    // Performance readout
+    addAndMakeVisible(mPerformanceLabel);
+    mPerformanceLabel.setFont(juce::Font(12.0f));
+
+    addAndMakeVisible(mPerformanceResetButton);
+    mPerformanceResetButton.setButtonText("Reset");
+    mPerformanceResetButton.onClick = [this] { audioProcessor.getPerformanceMonitor().reset(); };
+
+    addAndMakeVisible(mPerformanceExportButton);
+    mPerformanceExportButton.setButtonText("Export CSV");
+    mPerformanceExportButton.onClick = [this] { exportPerformance(); };
+
+    // Signal display under it
+    addAndMakeVisible(mSignalView);
+
+    // Presets along the very bottom
+    addAndMakeVisible(mPresetLabel);
+    mPresetLabel.setText("Preset", juce::dontSendNotification);
+
+    addAndMakeVisible(mPresetBox);
+    mPresetBox.onChange = [this] {
+        const int index = mPresetBox.getSelectedId() - 1;
+        if (index >= 0 && index != audioProcessor.getCurrentProgram()) {
+            audioProcessor.setCurrentProgram(index);
+        }
+    };
+
+    addAndMakeVisible(mSavePresetButton);
+    mSavePresetButton.setButtonText("Save As...");
+    mSavePresetButton.onClick = [this] { savePreset(); };
+
+    mPresetListSize = -1;
+    mPresetListSelection = -1;
+
+    timerCallback();
+    startTimerHz(10);
+
+    // Make sure that before the constructor has finished, you've set the
+    // editor's size to whatever you need it to be.
+    setResizable(true, true);
+    setResizeLimits(MIN_WIDTH, MIN_HEIGHT, MAX_WIDTH, MAX_HEIGHT);
+    setSize(WINDOW_WIDTH, WINDOW_HEIGHT);
 }
 
 
-void TelayAudioProcessorEditor::createLabelAndSlider(juce::Label* label, std::string labelText, juce::Slider* slider,
-    int x, int y, int width, int height) {
+void TelayAudioProcessorEditor::createLabelAndSlider(juce::Label* label, std::string labelText, juce::Slider* slider) {
     addAndMakeVisible(label);
     label->setText(labelText, juce::dontSendNotification);
     label->attachToComponent(slider, false);
 
     addAndMakeVisible(slider);
-    slider->setBounds(x, y, width, height);
     slider->setSliderStyle(juce::Slider::SliderStyle::RotaryVerticalDrag);
     slider->setTextBoxStyle(juce::Slider::TextBoxBelow, true, 50, 30);
 }
 
 
+void TelayAudioProcessorEditor::attachTapControls(int tap) {
+    // the old attachments have to go before the new ones take the sliders
+    mTapTimeAttach.reset();
+    mTapGainAttach.reset();
+    mTapPanAttach.reset();
+    mTapToneAttach.reset();
+
+    juce::String prefix = "Tap" + juce::String(tap + 1);
+    mTapTimeAttach.reset(new juce::AudioProcessorValueTreeState::SliderAttachment(valueTreeState, prefix + "Time", mTapTimeSlider));
+    mTapGainAttach.reset(new juce::AudioProcessorValueTreeState::SliderAttachment(valueTreeState, prefix + "Gain", mTapGainSlider));
+    mTapPanAttach.reset(new juce::AudioProcessorValueTreeState::SliderAttachment(valueTreeState, prefix + "Pan", mTapPanSlider));
+    mTapToneAttach.reset(new juce::AudioProcessorValueTreeState::SliderAttachment(valueTreeState, prefix + "Tone", mTapToneSlider));
+}
+
+
+void TelayAudioProcessorEditor::exportPerformance() {
+    mFileChooser.reset(new juce::FileChooser("Export performance log",
+        juce::File::getSpecialLocation(juce::File::userDocumentsDirectory).getChildFile("Telay performance.csv"), "*.csv"));
+
+    const int flags = juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::canSelectFiles
+        | juce::FileBrowserComponent::warnAboutOverwriting;
+    mFileChooser->launchAsync(flags, [this](const juce::FileChooser& chooser) {
+        const juce::File file = chooser.getResult();
+        if (file == juce::File()) {
+            return;
+        }
+
+        auto& monitor = audioProcessor.getPerformanceMonitor();
+        monitor.collect();
+        if (! monitor.writeCsv(file)) {
+            juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon, "Export failed",
+                "Couldn't write " + file.getFullPathName());
+        }
+    });
+}
+
+
+void TelayAudioProcessorEditor::savePreset() {
+    const int number = audioProcessor.getNumPrograms() + 1;
+    auto* window = new juce::AlertWindow("Save preset", "Store the current settings as a user preset.",
+        juce::MessageBoxIconType::NoIcon, this);
+    window->addTextEditor("name", "User " + juce::String(number), "Name");
+    window->addButton("Save", 1, juce::KeyPress(juce::KeyPress::returnKey));
+    window->addButton("Cancel", 0, juce::KeyPress(juce::KeyPress::escapeKey));
+
+    // the window deletes itself after the callback
+    juce::Component::SafePointer<TelayAudioProcessorEditor> editor(this);
+    window->enterModalState(true, juce::ModalCallbackFunction::create([editor, window](int result) {
+        const juce::String name = window->getTextEditorContents("name").trim();
+        if (editor == nullptr || result == 0 || name.isEmpty()) {
+            return;
+        }
+        editor->audioProcessor.saveUserPreset(name);
+        editor->updatePresetList();
+    }), true);
+}
+
+
+// Hosts and automation can switch programs too, so the list follows the processor
+void TelayAudioProcessorEditor::updatePresetList() {
+    const int numPresets = audioProcessor.getNumPrograms();
+    const int current = audioProcessor.getCurrentProgram();
+    if (numPresets == mPresetListSize && current == mPresetListSelection) {
+        return;
+    }
+
+    if (numPresets != mPresetListSize) {
+        mPresetBox.clear(juce::dontSendNotification);
+        for (int i = 0; i < numPresets; i++) {
+            if (i > 0 && audioProcessor.isUserPreset(i) && ! audioProcessor.isUserPreset(i - 1)) {
+                mPresetBox.addSeparator();
+            }
+            mPresetBox.addItem(audioProcessor.getProgramName(i), i + 1);
+        }
+        mPresetListSize = numPresets;
+    }
+    mPresetBox.setSelectedId(current + 1, juce::dontSendNotification);
+    mPresetListSelection = current;
+}
+
+
+void TelayAudioProcessorEditor::timerCallback() {
+    updatePresetList();
+
+
+    // the history has to be drained regularly or the audio thread starts dropping records
+    auto& monitor = audioProcessor.getPerformanceMonitor();
+    monitor.collect();
+
+    const auto summary = monitor.getSummary();
+    mPerformanceLabel.setText(juce::String::formatted("CPU %.1f%% avg, %.1f%% peak, worst %.0f us, %lld risky, %lld over",
+        summary.averageLoad * 100.0, summary.peakLoad * 100.0, summary.worstMicroseconds,
+        (long long)summary.numRiskyBlocks, (long long)summary.numOverruns), juce::dontSendNotification);
+}
+
+
 TelayAudioProcessorEditor::~TelayAudioProcessorEditor()
 {
+    stopTimer();
     mDryWetAttach.reset();
     mFeedbackAttach.reset();
     mDepthAttach.reset();
     mRateAttach.reset();
     mPhaseOffsetAttach.reset();
     mTypeAttach.reset();
+    mShapeAttach.reset();
+    mQualityAttach.reset();
+    mTimeModeAttach.reset();
+    mDivisionAttach.reset();
+    mOversamplingAttach.reset();
+    mMaxDelayAttach.reset();
+    mNumTapsAttach.reset();
+    mTapTimeAttach.reset();
+    mTapGainAttach.reset();
+    mTapPanAttach.reset();
+    mTapToneAttach.reset();
+    mLowCutAttach.reset();
+    mHighCutAttach.reset();
+    mDriveAttach.reset();
+    mWowFlutterAttach.reset();
+    mNumVoicesAttach.reset();
 }
 
 //==============================================================================
@@ -97,6 +348,66 @@ void TelayAudioProcessorEditor::paint(juce::Graphics& g)
 
 void TelayAudioProcessorEditor::resized()
 {
-    // This is generally where you'll want to lay out the positions of any
-    // subcomponents in your editor..
+    // the boxes, buttons and readouts keep their height, the three rows of knobs
+    // and the signal display share whatever the window has left
+    const int labelHeight = 24;
+    const int boxHeight = 30;
+    const int rowHeight = 24;
+    const int fixedHeight = 2 * (labelHeight + boxHeight + 6) + 3 * labelHeight + boxHeight + 2 * rowHeight + 64;
+    const int knobHeight = juce::jmax(40, (getHeight() - fixedHeight) / 4);
+
+    auto area = getLocalBounds().reduced(10, 6);
+
+    // effect type, LFO shape and quality, then the time and oversampling options
+    layOutRow(area.removeFromTop(labelHeight + boxHeight).withTrimmedTop(labelHeight),
+        { &mType, &mShape, &mQuality }, 5);
+    area.removeFromTop(6);
+    layOutRow(area.removeFromTop(labelHeight + boxHeight).withTrimmedTop(labelHeight),
+        { &mDivision, &mTimeMode, &mOversampling }, 5);
+    area.removeFromTop(6);
+
+    layOutRow(area.removeFromTop(labelHeight + knobHeight).withTrimmedTop(labelHeight),
+        { &mDryWetSlider, &mFeedbackSlider, &mDepthSlider, &mRateSlider, &mPhaseOffsetSlider }, 0);
+    area.removeFromTop(6);
+
+    layOutRow(area.removeFromTop(labelHeight + knobHeight).withTrimmedTop(labelHeight),
+        { &mNumTapsSlider, &mTapSelect, &mTapTimeSlider, &mTapGainSlider, &mTapPanSlider, &mTapToneSlider }, 0);
+    mTapSelect.setBounds(mTapSelect.getBounds().withSizeKeepingCentre(mTapSelect.getWidth() - 10, boxHeight));
+    area.removeFromTop(10);
+
+    // the max delay label sits to the left of its slider
+    auto maxDelayArea = area.removeFromTop(boxHeight);
+    maxDelayArea.removeFromLeft(80);
+    mMaxDelaySlider.setBounds(maxDelayArea);
+    area.removeFromTop(6);
+
+    layOutRow(area.removeFromTop(labelHeight + knobHeight).withTrimmedTop(labelHeight),
+        { &mLowCutSlider, &mHighCutSlider, &mDriveSlider, &mWowFlutterSlider, &mNumVoicesSlider }, 0);
+    area.removeFromTop(10);
+
+    auto performanceArea = area.removeFromTop(rowHeight);
+    mPerformanceExportButton.setBounds(performanceArea.removeFromRight(90));
+    performanceArea.removeFromRight(5);
+    mPerformanceResetButton.setBounds(performanceArea.removeFromRight(70));
+    mPerformanceLabel.setBounds(performanceArea);
+    area.removeFromTop(10);
+
+    auto presetArea = area.removeFromBottom(rowHeight);
+    mPresetLabel.setBounds(presetArea.removeFromLeft(60));
+    mSavePresetButton.setBounds(presetArea.removeFromRight(90));
+    presetArea.removeFromRight(10);
+    mPresetBox.setBounds(presetArea);
+    area.removeFromBottom(10);
+
+    mSignalView.setBounds(area);
+}
+
+
+// Splits a row evenly between its components, left to right
+void TelayAudioProcessorEditor::layOutRow(juce::Rectangle<int> row, std::initializer_list<juce::Component*> components,
+    int padding) {
+    const int width = row.getWidth() / (int)components.size();
+    for (auto* component : components) {
+        component->setBounds(row.removeFromLeft(width).reduced(padding, 0));
+    }
 }
\ No newline at end of file
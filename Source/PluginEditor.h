@@ -10,14 +10,21 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "SignalView.h"
 
-#define WINDOW_HEIGHT 480
+// the editor is resizable, resized() stacks the effect options, the knob rows, the
+// performance readout, the meters and the presets from the top of whatever size it gets
+#define WINDOW_HEIGHT 720
 #define WINDOW_WIDTH  480
+#define MIN_HEIGHT    640
+#define MIN_WIDTH     400
+#define MAX_HEIGHT    1400
+#define MAX_WIDTH     960
 
 //==============================================================================
 /**
 */
-class TelayAudioProcessorEditor : public juce::AudioProcessorEditor
+class TelayAudioProcessorEditor : public juce::AudioProcessorEditor, private juce::Timer
 {
 public:
     TelayAudioProcessorEditor(TelayAudioProcessor&, juce::AudioProcessorValueTreeState&);
@@ -27,8 +34,13 @@ public:
     void paint(juce::Graphics&) override;
     void resized() override;
 
-    void createLabelAndSlider(juce::Label* label, std::string labelText, juce::Slider* slider,
-        int x, int y, int width, int height);
+    void createLabelAndSlider(juce::Label* label, std::string labelText, juce::Slider* slider);
+    void layOutRow(juce::Rectangle<int> row, std::initializer_list<juce::Component*> components, int padding);
+    void attachTapControls(int tap);
+    void exportPerformance();
+    void savePreset();
+    void updatePresetList();
+    void timerCallback() override;
 
 private:
     // This reference is provided as a quick way for your editor to
@@ -60,4 +72,89 @@ private:
     juce::ComboBox mType;
     juce::Label mTypeLabel;
     std::unique_ptr <juce::AudioProcessorValueTreeState::ComboBoxAttachment> mTypeAttach;
+
+    juce::ComboBox mShape;
+    juce::Label mShapeLabel;
+    std::unique_ptr <juce::AudioProcessorValueTreeState::ComboBoxAttachment> mShapeAttach;
+
+    juce::ComboBox mQuality;
+    juce::Label mQualityLabel;
+    std::unique_ptr <juce::AudioProcessorValueTreeState::ComboBoxAttachment> mQualityAttach;
+
+    juce::ComboBox mTimeMode;
+    juce::Label mTimeModeLabel;
+    std::unique_ptr <juce::AudioProcessorValueTreeState::ComboBoxAttachment> mTimeModeAttach;
+
+    juce::ComboBox mDivision;
+    juce::Label mDivisionLabel;
+    std::unique_ptr <juce::AudioProcessorValueTreeState::ComboBoxAttachment> mDivisionAttach;
+
+    juce::ComboBox mOversampling;
+    juce::Label mOversamplingLabel;
+    std::unique_ptr <juce::AudioProcessorValueTreeState::ComboBoxAttachment> mOversamplingAttach;
+
+    juce::Slider mMaxDelaySlider;
+    juce::Label mMaxDelayLabel;
+    std::unique_ptr <juce::AudioProcessorValueTreeState::SliderAttachment> mMaxDelayAttach;
+
+    // Multi-tap, one set of knobs edits whichever tap is selected
+    juce::Slider mNumTapsSlider;
+    juce::Label mNumTapsLabel;
+    std::unique_ptr <juce::AudioProcessorValueTreeState::SliderAttachment> mNumTapsAttach;
+
+    juce::ComboBox mTapSelect;
+    juce::Label mTapSelectLabel;
+
+    juce::Slider mTapTimeSlider;
+    juce::Label mTapTimeLabel;
+    std::unique_ptr <juce::AudioProcessorValueTreeState::SliderAttachment> mTapTimeAttach;
+
+    juce::Slider mTapGainSlider;
+    juce::Label mTapGainLabel;
+    std::unique_ptr <juce::AudioProcessorValueTreeState::SliderAttachment> mTapGainAttach;
+
+    juce::Slider mTapPanSlider;
+    juce::Label mTapPanLabel;
+    std::unique_ptr <juce::AudioProcessorValueTreeState::SliderAttachment> mTapPanAttach;
+
+    juce::Slider mTapToneSlider;
+    juce::Label mTapToneLabel;
+    std::unique_ptr <juce::AudioProcessorValueTreeState::SliderAttachment> mTapToneAttach;
+
+    // Feedback loop tone
+    juce::Slider mLowCutSlider;
+    juce::Label mLowCutLabel;
+    std::unique_ptr <juce::AudioProcessorValueTreeState::SliderAttachment> mLowCutAttach;
+
+    juce::Slider mHighCutSlider;
+    juce::Label mHighCutLabel;
+    std::unique_ptr <juce::AudioProcessorValueTreeState::SliderAttachment> mHighCutAttach;
+
+    juce::Slider mDriveSlider;
+    juce::Label mDriveLabel;
+    std::unique_ptr <juce::AudioProcessorValueTreeState::SliderAttachment> mDriveAttach;
+
+    juce::Slider mWowFlutterSlider;
+    juce::Label mWowFlutterLabel;
+    std::unique_ptr <juce::AudioProcessorValueTreeState::SliderAttachment> mWowFlutterAttach;
+
+    juce::Slider mNumVoicesSlider;
+    juce::Label mNumVoicesLabel;
+    std::unique_ptr <juce::AudioProcessorValueTreeState::SliderAttachment> mNumVoicesAttach;
+
+    // processBlock timing, refreshed from the processor's PerformanceMonitor
+    juce::Label mPerformanceLabel;
+    juce::TextButton mPerformanceResetButton;
+    juce::TextButton mPerformanceExportButton;
+    std::unique_ptr<juce::FileChooser> mFileChooser;
+
+    // meters, LFO and delay line, fed from the processor's SignalMonitor
+    SignalView mSignalView;
+
+    // the processor's programs, factory ones first
+    juce::ComboBox mPresetBox;
+    juce::Label mPresetLabel;
+    juce::TextButton mSavePresetButton;
+    int mPresetListSize;
+    int mPresetListSelection;
 };
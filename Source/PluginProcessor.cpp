@@ -8,6 +8,7 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "AllocationGuard.h"
 
 const std::string DRY_WET_ID = "DryWet";
 const std::string FEEDBACK_ID = "Feedback";
@@ -15,6 +16,56 @@ const std::string DEPTH_ID = "Depth";
 const std::string RATE_ID = "Rate";
 const std::string PHASE_OFFSET_ID = "PhaseOffset";
 const std::string TYPE_ID = "Type";
+const std::string SHAPE_ID = "Shape";
+const std::string QUALITY_ID = "Quality";
+const std::string TIME_MODE_ID = "TimeMode";
+const std::string NUM_TAPS_ID = "Taps";
+const std::string DIVISION_ID = "Division";
+const std::string MAX_DELAY_ID = "MaxDelay";
+const std::string OVERSAMPLING_ID = "Oversampling";
+const std::string LOW_CUT_ID = "LowCut";
+const std::string HIGH_CUT_ID = "HighCut";
+const std::string DRIVE_ID = "Drive";
+const std::string WOW_FLUTTER_ID = "WowFlutter";
+const std::string NUM_VOICES_ID = "Voices";
+
+// Note divisions for the tempo synced modes, each straight, dotted and triplet
+static const int numNoteValues = 6;
+static const float noteBeats[numNoteValues] = { 4.0f, 2.0f, 1.0f, 0.5f, 0.25f, 0.125f };
+static const float feelFactors[3] = { 1.0f, 1.5f, 2.0f / 3.0f };
+
+// multi-tap parameters are numbered from 1, e.g. "Tap3Gain"
+static std::string tapParameterID(int tap, const std::string& name)
+{
+    return "Tap" + std::to_string(tap + 1) + name;
+}
+
+// how far apart the chorus voices' LFO rates are spread, either way of the Rate knob
+static const float voiceDetune = 0.12f;
+
+// length of a delay time crossfade
+static const float crossfadeTime = 0.05f;
+
+// length of the crossfade from one effect type to another
+static const float transitionTime = 0.05f;
+
+// engine samples between the steps of a gliding phase offset
+static const int phaseOffsetStep = 64;
+
+// peak level (-100 dBFS) below which input and tail count as silence
+static const float silenceThreshold = 1.0e-5f;
+
+// how much further back than the longest delay a read reaches, wow and flutter's
+// swing and the interpolators' taps with room to spare, in seconds
+static const float silenceMargin = 0.005f;
+
+// Interpolation kernel for each quality tier and effect type
+static const Interpolation interpolationTiers[3][TelayAudioProcessor::numEffectTypes] = {
+    //  Delay                   Chorus                   Flanger                  Multi-Tap                Ping-Pong                Rhythm
+    { Interpolation::linear,  Interpolation::linear,   Interpolation::linear,   Interpolation::linear,   Interpolation::linear,   Interpolation::linear  }, // Draft
+    { Interpolation::hermite, Interpolation::lagrange, Interpolation::allpass,  Interpolation::hermite,  Interpolation::hermite,  Interpolation::hermite }, // Standard
+    { Interpolation::sinc,    Interpolation::sinc,     Interpolation::sinc,     Interpolation::sinc,     Interpolation::sinc,     Interpolation::sinc    }  // High
+};
 
 //==============================================================================
 TelayAudioProcessor::TelayAudioProcessor()
@@ -28,48 +79,161 @@ TelayAudioProcessor::TelayAudioProcessor()
 #endif
     ),
 #endif
-    params(*this, nullptr, juce::Identifier("Telay"),
-        {
-            std::make_unique<juce::AudioParameterFloat>(DRY_WET_ID, "Dry Wet", 0.0f, 1.0f, 0.5f),
-            std::make_unique<juce::AudioParameterFloat>(FEEDBACK_ID, "Feedback", 0.0f, 0.98f, 0.5f),
-            std::make_unique<juce::AudioParameterFloat>(DEPTH_ID, "Depth", 0.0f, 1.0f, 0.5f),
-            std::make_unique<juce::AudioParameterFloat>(RATE_ID, "Rate", 0.1f, MAX_DELAY_TIME * 10, 10.f),
-            std::make_unique<juce::AudioParameterFloat>(PHASE_OFFSET_ID, "Phase Offset", 0.0f, 1.f, 0.f),
-            std::make_unique<juce::AudioParameterInt>(TYPE_ID, "Type", 0, 2, 0)
-        }
-    )
+    params(*this, nullptr, juce::Identifier("Telay"), createParameterLayout()),
+    mPresets(params)
 {
     // pointers to parameters
     mDryWetParameter = (juce::AudioParameterFloat*)params.getParameter(DRY_WET_ID);
     mFeedbackParameter = (juce::AudioParameterFloat*)params.getParameter(FEEDBACK_ID);
+    mLowCutParameter = (juce::AudioParameterFloat*)params.getParameter(LOW_CUT_ID);
+    mHighCutParameter = (juce::AudioParameterFloat*)params.getParameter(HIGH_CUT_ID);
+    mDriveParameter = (juce::AudioParameterFloat*)params.getParameter(DRIVE_ID);
+    mWowFlutterParameter = (juce::AudioParameterFloat*)params.getParameter(WOW_FLUTTER_ID);
     mDepthParameter = (juce::AudioParameterFloat*)params.getParameter(DEPTH_ID);
     mRateParameter = (juce::AudioParameterFloat*)params.getParameter(RATE_ID);
     mPhaseOffsetParameter = (juce::AudioParameterFloat*)params.getParameter(PHASE_OFFSET_ID);
     mTypeParameter = (juce::AudioParameterInt*)params.getParameter(TYPE_ID);
+    mShapeParameter = (juce::AudioParameterInt*)params.getParameter(SHAPE_ID);
+    mQualityParameter = (juce::AudioParameterInt*)params.getParameter(QUALITY_ID);
+    mTimeModeParameter = (juce::AudioParameterInt*)params.getParameter(TIME_MODE_ID);
+    mDivisionParameter = (juce::AudioParameterInt*)params.getParameter(DIVISION_ID);
+    mMaxDelayParameter = (juce::AudioParameterInt*)params.getParameter(MAX_DELAY_ID);
+    mOversamplingParameter = (juce::AudioParameterInt*)params.getParameter(OVERSAMPLING_ID);
+    mNumVoicesParameter = (juce::AudioParameterInt*)params.getParameter(NUM_VOICES_ID);
+    mNumTapsParameter = (juce::AudioParameterInt*)params.getParameter(NUM_TAPS_ID);
+    for (int tap = 0; tap < MultiTap::maxTaps; tap++) {
+        mTapTimeParameters[tap] = (juce::AudioParameterFloat*)params.getParameter(tapParameterID(tap, "Time"));
+        mTapGainParameters[tap] = (juce::AudioParameterFloat*)params.getParameter(tapParameterID(tap, "Gain"));
+        mTapPanParameters[tap] = (juce::AudioParameterFloat*)params.getParameter(tapParameterID(tap, "Pan"));
+        mTapToneParameters[tap] = (juce::AudioParameterFloat*)params.getParameter(tapParameterID(tap, "Tone"));
+    }
 
-    mCircularBufferLeft = nullptr;
-    mCircularBufferRight = nullptr;
-    mCircularBufferWriteHead = 0;
-    mCircularBufferLength = 0;
-    mDelayReadHead = 0.0;
-    mLFOPhase = 0.0;
-    mDelayTimeInSamples = 0;
-    mFeedbackLeft = 0.0;
-    mFeedbackRight = 0.0;
+    // MIDI controllers that move a parameter sample accurately, taken from the
+    // undefined ranges 20-31 and 102-119. Structural settings aren't mapped.
+    const std::pair<int, std::string> controllers[] = {
+        { 20, DRY_WET_ID }, { 21, FEEDBACK_ID }, { 22, DEPTH_ID }, { 23, RATE_ID }, { 24, PHASE_OFFSET_ID },
+        { 25, TYPE_ID }, { 26, SHAPE_ID }, { 27, TIME_MODE_ID }, { 28, DIVISION_ID }, { 29, LOW_CUT_ID },
+        { 30, HIGH_CUT_ID }, { 31, DRIVE_ID }, { 102, WOW_FLUTTER_ID }, { 103, NUM_VOICES_ID }, { 104, NUM_TAPS_ID }
+    };
+    std::fill(std::begin(mControllerParameters), std::end(mControllerParameters), nullptr);
+    for (auto& moved : mControllerMoved) {
+        moved = false;
+    }
+    for (const auto& controller : controllers) {
+        mControllerParameters[controller.first] = params.getParameter(controller.second);
+    }
+
+    mNumChannels = 0;
+    mAllocatedChannels = 0;
+    mPingPongFirst = -1;
+    mOversampler = nullptr;
+    mOversamplingBlockSize = 0;
+    mLatency = 0;
+    mLatencyChanged = false;
+    mMaxDelay = DEFAULT_MAX_DELAY_TIME;
+    mSampleRate = 44100.0;
+    mCrossfadeLength = (int)std::ceil(crossfadeTime * mSampleRate);
+    mQuietSamples = 0;
+    mQuietSamplesNeeded = 0;
+    mIsSilent = false;
+    mTailLength = 0.0f;
+    mLfoValue = 0.0f;
+    mEngineType = -1;
+    mOutgoingType = -1;
+    mTransitionSamples = 0;
+    mOutgoingDelayTime = 0.0f;
+    mPhaseOffset = 0.0f;
+    mPhaseOffsetCountdown = 0;
+
+    // Factory presets, each on top of the defaults. Division is note * 3 + feel,
+    // with straight, dotted and triplet feels.
+    mPresets.addFactoryPreset("Init", {});
+    mPresets.addFactoryPreset("Tape Echo", { { TYPE_ID, typeDelay }, { RATE_ID, 3.5f }, { FEEDBACK_ID, 0.55f },
+        { DRY_WET_ID, 0.35f }, { LOW_CUT_ID, 120.0f }, { HIGH_CUT_ID, 4500.0f }, { DRIVE_ID, 0.35f },
+        { WOW_FLUTTER_ID, 0.4f } });
+    mPresets.addFactoryPreset("Dark Repeats", { { TYPE_ID, typeDelay }, { RATE_ID, 5.0f }, { FEEDBACK_ID, 0.75f },
+        { DRY_WET_ID, 0.3f }, { HIGH_CUT_ID, 2500.0f }, { TIME_MODE_ID, timeModeCrossfade } });
+    mPresets.addFactoryPreset("Lush Chorus", { { TYPE_ID, typeChorus }, { RATE_ID, 0.8f }, { DEPTH_ID, 0.6f },
+        { FEEDBACK_ID, 0.1f }, { PHASE_OFFSET_ID, 0.25f }, { NUM_VOICES_ID, 4 } });
+    mPresets.addFactoryPreset("Jet Flanger", { { TYPE_ID, typeFlanger }, { RATE_ID, 0.25f }, { DEPTH_ID, 0.8f },
+        { FEEDBACK_ID, 0.7f }, { OVERSAMPLING_ID, 1 } });
+    mPresets.addFactoryPreset("Spread Taps", { { TYPE_ID, typeMultiTap }, { NUM_TAPS_ID, 6 }, { FEEDBACK_ID, 0.2f },
+        { DRY_WET_ID, 0.4f } });
+    mPresets.addFactoryPreset("Dotted Ping-Pong", { { TYPE_ID, typePingPong }, { DIVISION_ID, 10 },
+        { FEEDBACK_ID, 0.45f }, { DRY_WET_ID, 0.35f }, { HIGH_CUT_ID, 6000.0f } });
+    mPresets.addFactoryPreset("Eighth Rhythm", { { TYPE_ID, typeRhythm }, { DIVISION_ID, 9 }, { FEEDBACK_ID, 0.4f },
+        { DRY_WET_ID, 0.3f } });
+
+    // build the shared sinc table now rather than on the audio thread
+    Interpolators::WindowedSinc::getTable();
+
+    startTimerHz(30);
 }
 
-TelayAudioProcessor::~TelayAudioProcessor()
+juce::AudioProcessorValueTreeState::ParameterLayout TelayAudioProcessor::createParameterLayout()
+{
+    juce::AudioProcessorValueTreeState::ParameterLayout layout(
+        std::make_unique<juce::AudioParameterFloat>(DRY_WET_ID, "Dry Wet", 0.0f, 1.0f, 0.5f),
+        std::make_unique<juce::AudioParameterFloat>(FEEDBACK_ID, "Feedback", 0.0f, 0.98f, 0.5f),
+        std::make_unique<juce::AudioParameterFloat>(DEPTH_ID, "Depth", 0.0f, 1.0f, 0.5f),
+        std::make_unique<juce::AudioParameterFloat>(RATE_ID, "Rate", 0.1f, 20.f, 10.f),
+        std::make_unique<juce::AudioParameterFloat>(PHASE_OFFSET_ID, "Phase Offset", 0.0f, 1.f, 0.f),
+        std::make_unique<juce::AudioParameterInt>(TYPE_ID, "Type", 0, numEffectTypes - 1, typeDelay, juce::String(),
+            [](int value, int) { return getTypeName(value); },
+            [](const juce::String& text) {
+                for (int type = 0; type < numEffectTypes; type++) {
+                    if (text.equalsIgnoreCase(getTypeName(type))) {
+                        return type;
+                    }
+                }
+                return text.getIntValue();
+            }),
+        std::make_unique<juce::AudioParameterInt>(SHAPE_ID, "LFO Shape", 0, Lfo::numShapes - 1, Lfo::sine),
+        std::make_unique<juce::AudioParameterInt>(QUALITY_ID, "Quality", 0, 2, 1),
+        std::make_unique<juce::AudioParameterInt>(TIME_MODE_ID, "Time Mode", 0, 1, timeModeGlide),
+        // straight quarter notes
+        std::make_unique<juce::AudioParameterInt>(DIVISION_ID, "Division", 0, numNoteValues * 3 - 1, 6),
+        std::make_unique<juce::AudioParameterInt>(MAX_DELAY_ID, "Max Delay", 1, MAX_DELAY_TIME, DEFAULT_MAX_DELAY_TIME),
+        // 1x, 2x or 4x, for chorus and flanger
+        std::make_unique<juce::AudioParameterInt>(OVERSAMPLING_ID, "Oversampling", 0, numOversamplers, 0),
+        std::make_unique<juce::AudioParameterInt>(NUM_TAPS_ID, "Taps", 1, MultiTap::maxTaps, 4),
+        // Feedback loop tone, every stage is off at its default. Wow and flutter
+        // only apply to the delay modes, chorus and flanger are modulated already.
+        std::make_unique<juce::AudioParameterFloat>(LOW_CUT_ID, "Low Cut",
+            juce::NormalisableRange<float>(FeedbackChain::minLowCut, 2000.0f, 0.0f, 0.3f), FeedbackChain::minLowCut),
+        std::make_unique<juce::AudioParameterFloat>(HIGH_CUT_ID, "High Cut",
+            juce::NormalisableRange<float>(1000.0f, FeedbackChain::maxHighCut, 0.0f, 0.3f), FeedbackChain::maxHighCut),
+        std::make_unique<juce::AudioParameterFloat>(DRIVE_ID, "Drive", 0.0f, 1.0f, 0.0f),
+        std::make_unique<juce::AudioParameterFloat>(WOW_FLUTTER_ID, "Wow Flutter", 0.0f, 1.0f, 0.0f),
+        std::make_unique<juce::AudioParameterInt>(NUM_VOICES_ID, "Chorus Voices", 1, MAX_CHORUS_VOICES, 1));
+
+    // by default the taps fall on quarter seconds, fading away and alternating sides
+    for (int tap = 0; tap < MultiTap::maxTaps; tap++) {
+        const std::string name = "Tap " + std::to_string(tap + 1);
+        layout.add(
+            std::make_unique<juce::AudioParameterFloat>(tapParameterID(tap, "Time"), name + " Time",
+                juce::NormalisableRange<float>(0.01f, (float)MAX_DELAY_TIME, 0.0f, 0.3f),
+                juce::jmin(0.25f * (tap + 1), (float)DEFAULT_MAX_DELAY_TIME)),
+            std::make_unique<juce::AudioParameterFloat>(tapParameterID(tap, "Gain"), name + " Gain",
+                0.0f, 1.0f, std::pow(0.8f, (float)tap)),
+            std::make_unique<juce::AudioParameterFloat>(tapParameterID(tap, "Pan"), name + " Pan",
+                -1.0f, 1.0f, tap % 2 == 0 ? -0.5f : 0.5f),
+            std::make_unique<juce::AudioParameterFloat>(tapParameterID(tap, "Tone"), name + " Tone",
+                juce::NormalisableRange<float>(200.0f, 20000.0f, 0.0f, 0.25f), 8000.0f));
+    }
+
+    return layout;
+}
+
+juce::String TelayAudioProcessor::getTypeName(int type)
 {
-    mCircularBufferLeft.reset();
-    mCircularBufferRight.reset();
+    const char* names[numEffectTypes] = { "Delay", "Chorus", "Flanger", "Multi-Tap", "Ping-Pong", "Rhythm" };
+    return juce::isPositiveAndBelow(type, (int)numEffectTypes) ? names[type] : "";
+}
 
-    mCircularBufferWriteHead = 0;
-    mCircularBufferLength = 0;
-    mDelayReadHead = 0.0;
-    mDelayTimeInSamples = 0;
-    mFeedbackLeft = 0.0;
-    mFeedbackRight = 0.0;
-    mTimeSmoothed = 0.0;
+TelayAudioProcessor::~TelayAudioProcessor()
+{
+    stopTimer();
 }
 
 //==============================================================================
@@ -107,31 +271,40 @@ bool TelayAudioProcessor::isMidiEffect() const
 
 double TelayAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    return mTailLength.load();
 }
 
 int TelayAudioProcessor::getNumPrograms()
 {
-    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
-                // so this should be at least 1, even if you're not really implementing programs.
+    return mPresets.getNumPresets();
 }
 
 int TelayAudioProcessor::getCurrentProgram()
 {
-    return 0;
+    return mPresets.getCurrentPreset();
 }
 
+// The values reach the parameters at the start of the next block, all at once
 void TelayAudioProcessor::setCurrentProgram(int index)
 {
+    mPresets.select(index);
 }
 
 const juce::String TelayAudioProcessor::getProgramName(int index)
 {
-    return {};
+    return mPresets.getName(index);
 }
 
 void TelayAudioProcessor::changeProgramName(int index, const juce::String& newName)
 {
+    mPresets.rename(index, newName);
+}
+
+int TelayAudioProcessor::saveUserPreset(const juce::String& name)
+{
+    const int index = mPresets.addUserPreset(name);
+    updateHostDisplay(juce::AudioProcessorListener::ChangeDetails().withProgramChanged(true));
+    return index;
 }
 
 //==============================================================================
@@ -140,30 +313,149 @@ void TelayAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
     // init data for current sample rate
     // reset phase and reheads
 
-    mCircularBufferLength = sampleRate * MAX_DELAY_TIME;
-    if (mCircularBufferLeft == nullptr) {
-        mCircularBufferLeft = std::make_unique<float[]>(mCircularBufferLength);
+    // every channel of the (matched) layout gets its own ring and state
+    mNumChannels = juce::jmax(1, getTotalNumOutputChannels());
+
+    // The rings are sized for the user's maximum. Room for the longest one is
+    // reserved too, which only costs address space where pages commit lazily.
+    mMaxDelay = *mMaxDelayParameter;
+    mDelayLine.prepare(mNumChannels, (int)std::ceil(sampleRate * mMaxDelay), (int)std::ceil(sampleRate * MAX_DELAY_TIME));
+
+    // The rest only reallocates when it has to grow, some hosts call this on
+    // every transport start
+    if (mNumChannels > mAllocatedChannels) {
+        mFeedbackState.allocate((size_t)mNumChannels, true);
+        mAllpassState.allocate((size_t)mNumChannels, true);
+        mLfoPhaseOffsets.allocate((size_t)mNumChannels, true);
+        mChannelDelays.allocate((size_t)mNumChannels, true);
+        mPingPongSource.allocate((size_t)mNumChannels, true);
+        mOversampledChannels.allocate((size_t)mNumChannels, true);
+        mSubBlockChannels.allocate((size_t)mNumChannels, true);
+        mAllocatedChannels = mNumChannels;
+
+        // Polyphase IIR halfbands are the cheapest per sample. Their latency is
+        // rounded to a whole sample so the dry path can be delayed to match.
+        for (int i = 0; i < numOversamplers; i++) {
+            mOversamplers[i].reset(new juce::dsp::Oversampling<float>((size_t)mNumChannels, (size_t)(i + 1),
+                juce::dsp::Oversampling<float>::filterHalfBandPolyphaseIIR, false, true));
+        }
+        mOversamplingBlockSize = 0;
     }
     else {
-        mCircularBufferLeft.reset(new float[mCircularBufferLength]);
+        juce::FloatVectorOperations::clear(mFeedbackState.get(), mNumChannels);
+        juce::FloatVectorOperations::clear(mAllpassState.get(), mNumChannels);
     }
-    juce::zeromem(mCircularBufferLeft.get(), sizeof(float) * mCircularBufferLength);
+    mMultiTap.prepare(mNumChannels, sampleRate);
+    const auto layout = getChannelLayoutOfBus(false, 0);
+    mMultiTap.setPanChannels(layout.getChannelIndexForType(juce::AudioChannelSet::left),
+        layout.getChannelIndexForType(juce::AudioChannelSet::right));
+
+    // ping-pong goes round the speakers in the layout's order
+    mPingPongFirst = -1;
+    int previousSpeaker = -1;
+    for (int channel = 0; channel < mNumChannels; channel++) {
+        const auto channelType = layout.getTypeOfChannel(channel);
+        mPingPongSource[(size_t)channel] = -1;
+        if (layout.getAmbisonicOrder() >= 0 || channelType == juce::AudioChannelSet::LFE
+            || channelType == juce::AudioChannelSet::LFE2) {
+            continue;
+        }
 
-    if (mCircularBufferRight == nullptr) {
-        mCircularBufferRight = std::make_unique<float[]>(mCircularBufferLength);
+        if (mPingPongFirst < 0) {
+            mPingPongFirst = channel;
+        }
+        else {
+            mPingPongSource[(size_t)channel] = previousSpeaker;
+        }
+        previousSpeaker = channel;
     }
-    else {
-        mCircularBufferRight.reset(new float[mCircularBufferLength]);
+    if (mPingPongFirst >= 0) {
+        mPingPongSource[(size_t)mPingPongFirst] = previousSpeaker;
     }
-    juce::zeromem(mCircularBufferRight.get(), sizeof(float) * mCircularBufferLength);
+    mFeedbackChain.prepare(mNumChannels);
 
-    mTimeSmoothed = *mRateParameter/10;
+    int maxLatency = 0;
+    for (auto& oversampler : mOversamplers) {
+        if (samplesPerBlock > mOversamplingBlockSize) {
+            oversampler->initProcessing((size_t)samplesPerBlock);
+        }
+        oversampler->reset();
+        maxLatency = juce::jmax(maxLatency, (int)oversampler->getLatencyInSamples());
+    }
+    mOversamplingBlockSize = juce::jmax(mOversamplingBlockSize, samplesPerBlock);
+
+    // the dry signal waits here for the oversampled wet, plus room for a block
+    mDryDelay.setSize(mAllocatedChannels, maxLatency + mOversamplingBlockSize, false, true, true);
+    mDryDelay.clear();
+    mOversampler = getOversamplerFor(*mTypeParameter);
+    mLatency = mOversampler != nullptr ? (int)mOversampler->getLatencyInSamples() : 0;
+    mLatencyChanged = false;
+    setLatencySamples(mLatency);
+
+    // offline, the random shape starts from the same points on every render
+    for (int voice = 0; voice < MAX_CHORUS_VOICES; voice++) {
+        if (isNonRealtime()) {
+            mLfos[voice].setSeed(voice + 1);
+        }
+        mLfos[voice].reset();
+    }
+    // nothing has played yet, the first block starts on whichever type is set
+    mEngineType = -1;
+    mOutgoingType = -1;
+    mTransitionSamples = 0;
+    mTimeSmoothed = *mRateParameter * mMaxDelay / 20;
+    mFadeTime = mTimeSmoothed;
+    mFadeSamples = 0;
+    mTempoBpm = 0.0;
+    mDivision = -1;
+    mSyncedTime = mTimeSmoothed;
+    mTempoRampSamples = 0;
+    mTempoRampStep = 0.0;
+
+    // the rings start empty, so silent input can skip the engine straight away
+    mQuietSamples = mDelayLine.getCapacity() + 1;
+    mIsSilent = false;
+    updateTailLength(*mTypeParameter, mTimeSmoothed, *mFeedbackParameter);
+
+    // start the smoothers on the current values, no ramp from stale ones
+    SmoothedParameter* smoothers[] = { &mDryWetSmoothed, &mFeedbackSmoothed, &mDepthSmoothed,
+        &mRateSmoothed, &mPhaseOffsetSmoothed };
+    juce::AudioParameterFloat* smoothedParameters[] = { mDryWetParameter, mFeedbackParameter, mDepthParameter,
+        mRateParameter, mPhaseOffsetParameter };
+    for (int i = 0; i < juce::numElementsInArray(smoothers); i++) {
+        smoothers[i]->prepare(sampleRate, samplesPerBlock);
+        smoothers[i]->reset(*smoothedParameters[i]);
+    }
+    mPhaseOffset = *mPhaseOffsetParameter;
+    mPhaseOffsetCountdown = 0;
+
+    // cache the rate so the audio loops don't have to ask for it
+    mSampleRate = sampleRate;
+    mCrossfadeLength = (int)std::ceil(crossfadeTime * sampleRate);
+    mPerformance.prepare(sampleRate);
+    mPresets.setAudioRunning(true);
+
+    // SIMD aligned scratch space for delay times, wet signal and delay line input,
+    // used through a view of the channels and length needed now
+    const int numScratchChannels = numSharedScratchChannels + 4 * mNumChannels;
+    if (numScratchChannels > (int)mScratchAllocation.getNumChannels()
+        || samplesPerBlock > (int)mScratchAllocation.getNumSamples()) {
+        mScratchAllocation = juce::dsp::AudioBlock<float>(mScratchMemory,
+            (size_t)juce::jmax(numScratchChannels, (int)mScratchAllocation.getNumChannels()),
+            (size_t)juce::jmax(samplesPerBlock, (int)mScratchAllocation.getNumSamples()));
+    }
+    mScratch = mScratchAllocation.getSubsetChannelBlock(0, (size_t)numScratchChannels)
+        .getSubBlock(0, (size_t)samplesPerBlock);
+    for (int channel = 0; channel < mNumChannels; channel++) {
+        mChannelDelays[(size_t)channel] = getDelayScratch(channel);
+    }
 }
 
 void TelayAudioProcessor::releaseResources()
 {
-    // When playback stops, you can use this as an opportunity to free up any
-    // spare memory, etc.
+    // hand the delay memory back where the platform allows
+    mDelayLine.clear();
+    mPresets.setAudioRunning(false);
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -173,12 +465,9 @@ bool TelayAudioProcessor::isBusesLayoutSupported(const BusesLayout& layouts) con
     juce::ignoreUnused(layouts);
     return true;
 #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-        && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // The engine runs any number of channels, so mono, stereo, surround,
+    // immersive beds and ambisonics all work
+    if (layouts.getMainOutputChannelSet().isDisabled())
         return false;
 
     // This checks if the input layout matches the output layout
@@ -195,6 +484,12 @@ bool TelayAudioProcessor::isBusesLayoutSupported(const BusesLayout& layouts) con
 void TelayAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
     juce::ScopedNoDenormals noDenormals;
+    ScopedAllocationGuard allocationGuard;
+    PerformanceMonitor::ScopedBlock performanceBlock(mPerformance, buffer.getNumSamples());
+
+    // a preset switch lands here, before any parameter is read
+    mPresets.applyPending();
+
     auto totalNumInputChannels = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
@@ -202,138 +497,970 @@ void TelayAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::M
         buffer.clear(i, 0, buffer.getNumSamples());
     }
 
-    float* leftChannel = buffer.getWritePointer(0);
-    float* rightChannel = buffer.getWritePointer(1);
+    if (mScratch.getNumSamples() == 0) {
+        jassertfalse; // processBlock called before prepareToPlay?
+        return;
+    }
+
+    SignalMonitor::ScopedBlock signalBlock(mSignals, buffer);
+    signalBlock.lfoPhase = mLfos[0].getPhase();
+    signalBlock.lfoValue = mLfoValue;
+
+    // channels beyond the ones prepared for pass through dry
+    const int numChannels = juce::jmin(buffer.getNumChannels(), mNumChannels);
+    float* const* channelData = buffer.getArrayOfWritePointers();
+    const int numSamples = buffer.getNumSamples();
+
+    // A mapped controller moves its parameter on the sample it arrives at, so the
+    // block is split there and each part reads the parameters afresh. Renders then
+    // don't depend on the host's block size. Without controllers it is one part.
+    int start = 0;
+    for (const auto metadata : midiMessages) {
+        const auto message = metadata.getMessage();
+        if (! message.isController()) {
+            continue;
+        }
+        auto* parameter = mControllerParameters[message.getControllerNumber()];
+        if (parameter == nullptr) {
+            continue;
+        }
+
+        const int position = juce::jlimit(start, numSamples, metadata.samplePosition);
+        if (position > start) {
+            processSubBlock(channelData, numChannels, start, position - start, numSamples, performanceBlock);
+            start = position;
+        }
+        // the host and the editor hear about it from the message thread
+        parameter->setValue((float)message.getControllerValue() / 127.0f);
+        mControllerMoved[message.getControllerNumber()] = true;
+    }
+    if (start < numSamples || start == 0) {
+        processSubBlock(channelData, numChannels, start, numSamples - start, numSamples, performanceBlock);
+    }
+
+    signalBlock.lfoActive = mEngineType == typeChorus || mEngineType == typeFlanger;
+}
+
+void TelayAudioProcessor::processSubBlock(float* const* blockData, int numChannels, int start, int numSamples,
+    int blockSamples, PerformanceMonitor::ScopedBlock& performanceBlock) {
+    float* const* channelData = mSubBlockChannels;
+    for (int channel = 0; channel < numChannels; channel++) {
+        mSubBlockChannels[channel] = blockData[channel] + start;
+    }
+
+    // Read every parameter once per (sub-)block, the inner loops only see these copies
+    BlockParameters blockParams;
+    blockParams.dryWet = *mDryWetParameter;
+    blockParams.feedback = *mFeedbackParameter;
+    blockParams.depth = *mDepthParameter;
+    blockParams.rate = *mRateParameter;
+    blockParams.phaseOffset = *mPhaseOffsetParameter;
+    blockParams.lowCut = *mLowCutParameter;
+    blockParams.highCut = *mHighCutParameter;
+    blockParams.drive = *mDriveParameter;
+    blockParams.wowFlutter = *mWowFlutterParameter;
+    mDryWetSmoothed.setTarget(blockParams.dryWet);
+    mFeedbackSmoothed.setTarget(blockParams.feedback);
+    mDepthSmoothed.setTarget(blockParams.depth);
+    mRateSmoothed.setTarget(blockParams.rate);
+    mPhaseOffsetSmoothed.setTarget(blockParams.phaseOffset);
+    // A new type crossfades in from the old one, which finishes before another change
+    // can start. Straight after prepareToPlay or out of silence nothing is heard to
+    // fade from, and the two engines can only share the rings at the same rate.
+    const int requestedType = *mTypeParameter;
+    if (requestedType != mEngineType && mOutgoingType < 0) {
+        if (mEngineType >= 0 && ! mIsSilent && getOversamplerFor(requestedType) == getOversamplerFor(mEngineType)) {
+            mOutgoingType = mEngineType;
+            mTransitionSamples = 0;
+            mOutgoingDelayTime = mFadeSamples < mCrossfadeLength / 2 ? mTimeSmoothed : mFadeTime;
+            mOutgoingLfo.copyStateFrom(mLfos[0]);
+        }
+        // the taps start on their settings, not faded from wherever they last were
+        if (requestedType == typeMultiTap) {
+            mMultiTap.reset();
+        }
+        mEngineType = requestedType;
+    }
+    const int type = mEngineType;
+    blockParams.type = type;
+    performanceBlock.type = type;
+    blockParams.timeMode = *mTimeModeParameter;
+    blockParams.numVoices = *mNumVoicesParameter;
+    // offline renders are long, and their LFOs shouldn't drift over them
+    const bool offline = isNonRealtime();
+    for (auto& lfo : mLfos) {
+        lfo.setShape(*mShapeParameter);
+        lfo.setDoublePrecision(offline);
+    }
+    mOutgoingLfo.setShape(*mShapeParameter);
+    mOutgoingLfo.setDoublePrecision(offline);
+
+    // offline renders always get the most accurate kernel
+    const int quality = isNonRealtime() ? 2 : (int)*mQualityParameter;
+    blockParams.kernel = interpolationTiers[quality][juce::jlimit(0, numEffectTypes - 1, type)];
+    blockParams.outgoingKernel = interpolationTiers[quality][juce::jlimit(0, numEffectTypes - 1, mOutgoingType)];
+
+    // A new maximum delay resizes the rings within their reserved room and starts
+    // them empty, so the read heads jump straight to their new times. Without
+    // room to grow the old maximum holds until the next prepareToPlay.
+    const int maxDelay = *mMaxDelayParameter;
+    if (maxDelay != mMaxDelay && mDelayLine.setMaximumDelay((int)std::ceil(mSampleRate * maxDelay))) {
+        mMaxDelay = maxDelay;
+        mTimeSmoothed = *mRateParameter * mMaxDelay / 20;
+        mFadeTime = mTimeSmoothed;
+        mFadeSamples = 0;
+        mTempoRampSamples = 0;
+        mDivision = -1;
+        mQuietSamples = mDelayLine.getCapacity() + 1;
+    }
+    blockParams.maxDelayTime = (float)mMaxDelay;
+
+    // ping-pong and rhythm take their time from the host tempo, delay from the
+    // Rate knob, which spans up to the maximum delay
+    blockParams.delayTime = blockParams.rate * blockParams.maxDelayTime / 20;
+    if (type == typePingPong || type == typeRhythm) {
+        // the host's tempo is per block, so a change ramps over the rest of it
+        blockParams.delayTime = updateSyncedTime(*mDivisionParameter, blockSamples - start, blockParams.maxDelayTime);
+    }
+
+    if (type == typeMultiTap || mOutgoingType == typeMultiTap) {
+        mMultiTap.setNumTaps(*mNumTapsParameter);
+        for (int tap = 0; tap < mMultiTap.getNumTaps(); tap++) {
+            const float time = juce::jmin((float)*mTapTimeParameters[tap], blockParams.maxDelayTime);
+            mMultiTap.setTap(tap, (float)(mSampleRate * time), *mTapGainParameters[tap],
+                *mTapPanParameters[tap], *mTapToneParameters[tap]);
+        }
+    }
+
+    const int maxScratch = (int)mScratch.getNumSamples();
+
+    updateTailLength(type, blockParams.delayTime, juce::jmax(blockParams.feedback, mFeedbackSmoothed.getCurrentValue()));
+
+    // Nothing above the threshold has gone into the rings for longer than the
+    // longest delay in use reaches back, so with silent input the wet signal is
+    // silence too. Offline renders skip the shortcut: it needs a whole block of
+    // silence, so where it kicked in would depend on the block size.
+    if (! offline && mQuietSamples > mQuietSamplesNeeded && isSilent(channelData, numChannels, numSamples)) {
+        performanceBlock.silent = true;
+        processSilentBlock(channelData, numChannels, numSamples, blockParams);
+        return;
+    }
+    mIsSilent = false;
+
+    // The modulated modes can run their read and feedback loop oversampled, which
+    // keeps a fast sweep from aliasing. The dry path stays at the host rate.
+    juce::dsp::Oversampling<float>* oversampler = getOversamplerFor(type);
+    setOversampler(oversampler);
+
+    if (oversampler == nullptr) {
+        processChunks(channelData, numChannels, numSamples, blockParams, mSampleRate, false);
+        return;
+    }
+
+    // the oversamplers are only prepared for blocks as long as promised
+    performanceBlock.oversampling = (int)oversampler->getOversamplingFactor();
+    for (int offset = 0; offset < numSamples;) {
+        const int length = juce::jmin(maxScratch, numSamples - offset);
+        processOversampled(oversampler, channelData, numChannels, offset, length, blockParams);
+        offset += length;
+    }
+}
+
+void TelayAudioProcessor::processOversampled(juce::dsp::Oversampling<float>* oversampler, float* const* channelData,
+    int numChannels, int start, int numSamples, const BlockParameters& blockParams) {
+    juce::dsp::AudioBlock<float> block(channelData, (size_t)numChannels, (size_t)start, (size_t)numSamples);
+
+    // the wet signal is worked out at the higher rate, then filtered back down
+    // over the top of the input
+    auto oversampled = oversampler->processSamplesUp(block);
+    for (int channel = 0; channel < numChannels; channel++) {
+        mOversampledChannels[channel] = oversampled.getChannelPointer((size_t)channel);
+    }
+    const double engineRate = mSampleRate * (double)oversampler->getOversamplingFactor();
+    processChunks(mOversampledChannels, numChannels, (int)oversampled.getNumSamples(), blockParams, engineRate, true);
+
+    // The input still sits in the block until it is filtered back down, so it
+    // goes through the dry delay first. That delay matches the filters' latency.
+    ChunkParameters chunkParams;
+    chunkParams.dryWetRamp = mDryWetSmoothed.process(numSamples);
+    chunkParams.dryWet = mDryWetSmoothed.getCurrentValue();
+
+    const int latency = mLatency;
+    for (int channel = 0; channel < numChannels; channel++) {
+        float* dry = mDryDelay.getWritePointer(channel);
+        juce::FloatVectorOperations::copy(dry + latency, channelData[channel] + start, numSamples);
+    }
+
+    oversampler->processSamplesDown(block);
+
+    for (int channel = 0; channel < numChannels; channel++) {
+        // the first numSamples of the dry delay line up with the wet block, the
+        // rest are carried on to the next one
+        float* dry = mDryDelay.getWritePointer(channel);
+        mixDryWet(dry, channelData[channel] + start, numSamples, chunkParams);
+        juce::FloatVectorOperations::copy(channelData[channel] + start, dry, numSamples);
+        std::copy(dry + numSamples, dry + numSamples + latency, dry);
+    }
+}
+
+juce::dsp::Oversampling<float>* TelayAudioProcessor::getOversamplerFor(int type) const {
+    if (type != typeChorus && type != typeFlanger) {
+        return nullptr;
+    }
+
+    const int oversampling = *mOversamplingParameter;
+    return oversampling > 0 ? mOversamplers[oversampling - 1].get() : nullptr;
+}
+
+void TelayAudioProcessor::setOversampler(juce::dsp::Oversampling<float>* oversampler) {
+    if (oversampler == mOversampler) {
+        return;
+    }
+
+    // A different factor starts from clean filters and an empty dry delay. The
+    // host hears about the new latency from the message thread.
+    mOversampler = oversampler;
+    int latency = 0;
+    if (oversampler != nullptr) {
+        oversampler->reset();
+        latency = (int)oversampler->getLatencyInSamples();
+    }
+    mDryDelay.clear();
+    mLatency = latency;
+    mLatencyChanged = true;
+}
+
+// Message thread. Whatever the audio thread can't tell the host itself waits
+// here, the audio thread only sets flags.
+void TelayAudioProcessor::timerCallback() {
+    if (mLatencyChanged.exchange(false)) {
+        setLatencySamples(mLatency);
+    }
+    mPresets.notifyHost();
+
+    // a controller move reaches the host as one complete gesture
+    for (int controller = 0; controller < 128; controller++) {
+        if (mControllerMoved[controller].exchange(false)) {
+            auto* parameter = mControllerParameters[controller];
+            parameter->beginChangeGesture();
+            parameter->setValueNotifyingHost(parameter->getValue());
+            parameter->endChangeGesture();
+        }
+    }
+}
+
+void TelayAudioProcessor::processChunks(float* const* channelData, int numChannels, int numSamples,
+    const BlockParameters& blockParams, double engineRate, bool wetOnly) {
+    const int type = blockParams.type;
+    const Interpolation kernel = blockParams.kernel;
+    const int maxScratch = (int)mScratch.getNumSamples();
+
+    // the loop filters run at the engine rate, so they follow the oversampling
+    mFeedbackChain.setParameters(blockParams.lowCut, blockParams.highCut, blockParams.drive,
+        isDelayType(type) ? blockParams.wowFlutter : 0.0f, engineRate);
+
+    // the editor's scope sweeps across the longest delay
+    mSignals.setScopeSweep(getLongestDelay(type, blockParams.delayTime) * engineRate);
+
+    // a type change crossfades over the same samples wherever the block splits
+    const int transitionLength = (int)std::ceil(transitionTime * engineRate);
+
+    for (int start = 0; start < numSamples;) {
+        // Hosts may send more samples than promised in prepareToPlay, and each
+        // chunk is read before it is written, so it can't be longer than the
+        // shortest delay in it either
+        int chunk = juce::jmin(maxScratch, numSamples - start);
+        chunk = juce::jmin(chunk, getMaxChunk(type, kernel, engineRate,
+            juce::jmin(mTimeSmoothed, mFadeTime, blockParams.delayTime)));
+
+        // A delay time crossfade, running or about to start, ends on a chunk boundary
+        // so the next one starts on the same sample however the block is split
+        if (isDelayType(type) && (! juce::exactlyEqual(mFadeTime, mTimeSmoothed)
+                || ! juce::exactlyEqual(mTimeSmoothed, blockParams.delayTime))) {
+            chunk = juce::jmin(chunk, mCrossfadeLength - mFadeSamples);
+        }
+
+        // and so does a tap's fade from its old time to its new one
+        if (type == typeMultiTap || mOutgoingType == typeMultiTap) {
+            chunk = juce::jmin(chunk, mMultiTap.getFadeSamplesLeft());
+        }
+
+        const int outgoingType = mOutgoingType;
+        if (outgoingType >= 0) {
+            // and the outgoing engine stops on the sample its fade ends
+            chunk = juce::jmin(chunk, getMaxChunk(outgoingType, blockParams.outgoingKernel, engineRate, mOutgoingDelayTime),
+                transitionLength - mTransitionSamples);
+        }
+
+        // The phase offset is one value per chunk. While it glides it steps on a grid
+        // counted from where the glide began, so the steps don't move with the block size.
+        if (mPhaseOffsetCountdown == 0) {
+            mPhaseOffset = mPhaseOffsetSmoothed.getCurrentValue();
+            if (mPhaseOffsetSmoothed.isSmoothing()) {
+                mPhaseOffsetCountdown = phaseOffsetStep;
+            }
+        }
+        if (mPhaseOffsetCountdown > 0) {
+            chunk = juce::jmin(chunk, mPhaseOffsetCountdown);
+            mPhaseOffsetCountdown -= chunk;
+        }
+
+        // advance every smoother even if this mode doesn't use it, so switching modes
+        // doesn't jump. Dry/wet is left to the caller when it mixes afterwards.
+        ChunkParameters chunkParams;
+        chunkParams.dryWetRamp = wetOnly ? nullptr : mDryWetSmoothed.process(chunk);
+        chunkParams.feedbackRamp = mFeedbackSmoothed.process(chunk);
+        chunkParams.depthRamp = mDepthSmoothed.process(chunk);
+        chunkParams.rateRamp = mRateSmoothed.process(chunk);
+        mPhaseOffsetSmoothed.process(chunk);
+        chunkParams.dryWet = mDryWetSmoothed.getCurrentValue();
+        chunkParams.feedback = mFeedbackSmoothed.getCurrentValue();
+        chunkParams.depth = mDepthSmoothed.getCurrentValue();
+        chunkParams.rate = mRateSmoothed.getCurrentValue();
+        chunkParams.phaseOffset = mPhaseOffset;
+
+        // the delay modes share the tape's wow and flutter, an outgoing one wobbles as it fades
+        const float* wowFlutter = nullptr;
+        if ((isDelayType(type) || (outgoingType >= 0 && isDelayType(outgoingType))) && mFeedbackChain.hasWowFlutter()) {
+            float* offsets = mScratch.getChannelPointer(scratchWowFlutter);
+            mFeedbackChain.modulate(offsets, chunk);
+            wowFlutter = offsets;
+        }
 
-    float* outSamples;
+        // Only while the type changes, the outgoing engine reads first and its wet
+        // signal and feedback are put aside, then the incoming one reads as usual
+        if (outgoingType >= 0) {
+            float* fade = mScratch.getChannelPointer(scratchTransitionFade);
+            float* fadeOut = mScratch.getChannelPointer(scratchTransitionOut);
+            float* fadeIn = mScratch.getChannelPointer(scratchTransitionIn);
+            for (int sample = 0; sample < chunk; sample++) {
+                fade[sample] = (float)(mTransitionSamples + sample + 1) / (float)transitionLength;
+                fadeOut[sample] = std::cos(fade[sample] * juce::MathConstants<float>::halfPi);
+                fadeIn[sample] = std::sin(fade[sample] * juce::MathConstants<float>::halfPi);
+            }
+
+            renderWet(outgoingType, blockParams.outgoingKernel, numChannels, chunk, blockParams, chunkParams, engineRate,
+                wowFlutter, true);
+            for (int channel = 0; channel < numChannels; channel++) {
+                juce::FloatVectorOperations::copy(getOutgoingWetScratch(channel), getWetScratch(channel), chunk);
+                juce::FloatVectorOperations::copy(getOutgoingFeedbackScratch(channel),
+                    outgoingType == typeMultiTap ? getDelayScratch(channel) : getWetScratch(channel), chunk);
+            }
+        }
+
+        renderWet(type, kernel, numChannels, chunk, blockParams, chunkParams, engineRate,
+            isDelayType(type) ? wowFlutter : nullptr, false);
+
+        // input plus feedback goes into the delay line
+        float writtenPeak = 0.0f;
+        if (outgoingType >= 0) {
+            writtenPeak = writeTransition(channelData, start, numChannels, chunk, type, chunkParams);
+        }
+        else if (type == typePingPong) {
+            // All the speakers' input goes into the first one and each feeds back into
+            // the next one, a rotation for the cross-feedback matrix, so the repeats
+            // bounce L, R, L... in stereo and travel round the speakers in surround
+            const float* input = mixPingPongInput(channelData, start, numChannels, chunk);
+            for (int channel = 0; channel < numChannels; channel++) {
+                writtenPeak = juce::jmax(writtenPeak, writeWithFeedback(channel,
+                    getPingPongInput(channelData, start, input, channel), getWetScratch(getPingPongSource(channel)),
+                    mFeedbackState[(size_t)channel], chunk, chunkParams));
+            }
+        }
+        else {
+            for (int channel = 0; channel < numChannels; channel++) {
+                const float* feedbackSource = type == typeMultiTap ? getDelayScratch(channel) : getWetScratch(channel);
+                writtenPeak = juce::jmax(writtenPeak, writeWithFeedback(channel, channelData[channel] + start,
+                    feedbackSource, mFeedbackState[(size_t)channel], chunk, chunkParams));
+            }
+        }
+        mDelayLine.advance(chunk);
+
+        if (writtenPeak < silenceThreshold) {
+            mQuietSamples = juce::jmin(mQuietSamples + chunk, mDelayLine.getCapacity() + 1);
+        }
+        else {
+            mQuietSamples = 0;
+        }
+
+        // the chorus voices are mostly uncorrelated, so they are heard at equal power rather than averaged
+        if (blockParams.numVoices > 1 && (type == typeChorus || outgoingType == typeChorus)) {
+            const float voiceGain = std::sqrt((float)blockParams.numVoices);
+            for (int channel = 0; channel < numChannels; channel++) {
+                float* wet = type == typeChorus ? getWetScratch(channel) : getOutgoingWetScratch(channel);
+                juce::FloatVectorOperations::multiply(wet, voiceGain, chunk);
+            }
+        }
+
+        // The two engines are heard at equal power, they are different enough not to
+        // add up like copies. Once the fade is over the outgoing one is dropped.
+        if (outgoingType >= 0) {
+            const float* fadeOut = mScratch.getChannelPointer(scratchTransitionOut);
+            const float* fadeIn = mScratch.getChannelPointer(scratchTransitionIn);
+            for (int channel = 0; channel < numChannels; channel++) {
+                float* wet = getWetScratch(channel);
+                const float* outgoing = getOutgoingWetScratch(channel);
+                for (int sample = 0; sample < chunk; sample++) {
+                    wet[sample] = fadeOut[sample] * outgoing[sample] + fadeIn[sample] * wet[sample];
+                }
+            }
+
+            mTransitionSamples += chunk;
+            if (mTransitionSamples >= transitionLength) {
+                mOutgoingType = -1;
+                mTransitionSamples = 0;
+            }
+        }
 
-    for (int sample = 0; sample < buffer.getNumSamples(); sample++) {
-        // Write to delay buffer
-        mCircularBufferLeft.get()[mCircularBufferWriteHead] = leftChannel[sample] + mFeedbackLeft;
-        mCircularBufferRight.get()[mCircularBufferWriteHead] = rightChannel[sample] + mFeedbackRight;
+        // mix dry/wet ratio of incoming samples with delayed samples
+        for (int channel = 0; channel < numChannels; channel++) {
+            if (wetOnly) {
+                juce::FloatVectorOperations::copy(channelData[channel] + start, getWetScratch(channel), chunk);
+            }
+            else {
+                mixDryWet(channelData[channel] + start, getWetScratch(channel), chunk, chunkParams);
+            }
+        }
 
-        // Iterate writeIndex, wrapping to 0 at the end (Circular)
-        mCircularBufferWriteHead = (mCircularBufferWriteHead + 1) % mCircularBufferLength;
+        start += chunk;
+    }
+}
 
-        // *mTypeParameter == 0 == false, Delay
-        // *mTypeParameter > 0 == true, Chorus, Flanger
-        if (*mTypeParameter) {
-            outSamples = lfoSamplesOut(leftChannel, rightChannel, sample);
+void TelayAudioProcessor::renderWet(int type, Interpolation kernel, int numChannels, int numSamples,
+    const BlockParameters& blockParams, const ChunkParameters& chunkParams, double engineRate, const float* wowFlutter,
+    bool isOutgoing) {
+    const float maxDelayInSamples = (float)(mSampleRate * blockParams.maxDelayTime);
+
+    // the outgoing engine sweeps on its own copy of the first LFO
+    Lfo& firstLfo = isOutgoing ? mOutgoingLfo : mLfos[0];
+
+    bool isStatic = false;
+    switch (type) {
+    case typeChorus:
+        // Chorus sweeps 5-30ms, this is the first voice, any others are read further down
+        computeModulatedTimes(firstLfo, getVoiceRateScale(0, blockParams.numVoices), 0.0f, numChannels, numSamples,
+            chunkParams, engineRate, 0.005f, 0.03f);
+        break;
+    case typeFlanger:
+        // Flanger sweeps 1-5ms
+        computeModulatedTimes(firstLfo, 1.0f, 0.0f, numChannels, numSamples, chunkParams, engineRate, 0.001f, 0.005f);
+        break;
+    case typeMultiTap:
+        // the taps hold their times for the block
+        break;
+    default:
+        if (isOutgoing) {
+            // the incoming engine owns the time glide, the outgoing one holds still
+            juce::FloatVectorOperations::fill(mChannelDelays[0], (float)(mSampleRate * mOutgoingDelayTime), numSamples);
+            isStatic = true;
         }
         else {
-            outSamples = delaySamplesOut(leftChannel, rightChannel, sample);
+            isStatic = computeDelayTimes(mChannelDelays[0], numSamples, blockParams, blockParams.timeMode);
+        }
+        if (wowFlutter != nullptr) {
+            addWowFlutter(mChannelDelays[0], wowFlutter, numSamples, maxDelayInSamples);
+            isStatic = false;
+        }
+        break;
+    }
+
+    if (type == typeMultiTap) {
+        // the longest tap feeds back, it lands in the otherwise unused delay scratch
+        for (int channel = 0; channel < numChannels; channel++) {
+            mMultiTap.process(mDelayLine, kernel, channel, getWetScratch(channel), getDelayScratch(channel),
+                mScratch.getChannelPointer(scratchFadeDelay), mScratch.getChannelPointer(scratchCrossfade),
+                mScratch.getChannelPointer(scratchTapFade), numSamples);
+        }
+        mMultiTap.advance(numSamples);
+    }
+    else {
+        // interpolated samples for the whole chunk, in delay mode every channel reads at the same time
+        for (int channel = 0; channel < numChannels; channel++) {
+            readTap(kernel, channel, mChannelDelays[isDelayType(type) ? 0 : channel], isStatic, getWetScratch(channel),
+                numSamples, mAllpassState[channel]);
+        }
+
+        if (type == typeChorus && blockParams.numVoices > 1) {
+            addChorusVoices(kernel, numChannels, numSamples, blockParams.numVoices, chunkParams, engineRate);
+        }
+    }
+
+    if (! isOutgoing && isDelayType(type) && ! juce::exactlyEqual(mFadeTime, mTimeSmoothed)) {
+        for (int channel = 0; channel < numChannels; channel++) {
+            crossfadeTap(kernel, channel, getWetScratch(channel), numSamples, wowFlutter, maxDelayInSamples);
+        }
+
+        mFadeSamples += numSamples;
+        if (mFadeSamples >= mCrossfadeLength) {
+            // the new tap takes over
+            mTimeSmoothed = mFadeTime;
+            mFadeSamples = 0;
+        }
+    }
+}
+
+float TelayAudioProcessor::writeTransition(float* const* channelData, int start, int numChannels, int numSamples,
+    int type, const ChunkParameters& chunkParams) {
+    // What goes into the rings fades linearly from one engine's routing and feedback
+    // to the other's, so the loop gain never rises above the Feedback setting
+    const int outgoingType = mOutgoingType;
+    const float* fade = mScratch.getChannelPointer(scratchTransitionFade);
+    float* mixedInput = mScratch.getChannelPointer(scratchTransitionInput);
+    float* mixedFeedback = mScratch.getChannelPointer(scratchTransitionFeedback);
+
+    // ping-pong feeds all the speakers' input into the first one
+    const float* pingPongInput = nullptr;
+    if (type == typePingPong || outgoingType == typePingPong) {
+        pingPongInput = mixPingPongInput(channelData, start, numChannels, numSamples);
+    }
+    const auto getInput = [&](int engineType, int channel) -> const float* {
+        if (engineType == typePingPong) {
+            return getPingPongInput(channelData, start, pingPongInput, channel);
+        }
+        return channelData[channel] + start;
+    };
+
+    float writtenPeak = 0.0f;
+    for (int channel = 0; channel < numChannels; channel++) {
+        const int source = getPingPongSource(channel);
+        const float* incoming = type == typeMultiTap ? getDelayScratch(channel)
+            : getWetScratch(type == typePingPong ? source : channel);
+        const float* outgoing = getOutgoingFeedbackScratch(outgoingType == typePingPong ? source : channel);
+        for (int sample = 0; sample < numSamples; sample++) {
+            mixedFeedback[sample] = outgoing[sample] + fade[sample] * (incoming[sample] - outgoing[sample]);
+        }
+
+        // a null input is silence
+        const float* input = getInput(type, channel);
+        const float* outgoingInput = getInput(outgoingType, channel);
+        if (input != outgoingInput) {
+            for (int sample = 0; sample < numSamples; sample++) {
+                const float in = input != nullptr ? input[sample] : 0.0f;
+                const float out = outgoingInput != nullptr ? outgoingInput[sample] : 0.0f;
+                mixedInput[sample] = out + fade[sample] * (in - out);
+            }
+            input = mixedInput;
+        }
+
+        writtenPeak = juce::jmax(writtenPeak, writeWithFeedback(channel, input, mixedFeedback,
+            mFeedbackState[(size_t)channel], numSamples, chunkParams));
+    }
+    return writtenPeak;
+}
+
+// Averages the input of the speakers in the ping-pong rotation
+const float* TelayAudioProcessor::mixPingPongInput(float* const* channelData, int start, int numChannels,
+    int numSamples) {
+    float* input = mScratch.getChannelPointer(scratchPingPongInput);
+    juce::FloatVectorOperations::clear(input, numSamples);
+    int numSpeakers = 0;
+    for (int channel = 0; channel < numChannels; channel++) {
+        if (mPingPongSource[(size_t)channel] >= 0) {
+            juce::FloatVectorOperations::add(input, channelData[channel] + start, numSamples);
+            numSpeakers++;
+        }
+    }
+    if (numSpeakers > 1) {
+        juce::FloatVectorOperations::multiply(input, 1.0f / numSpeakers, numSamples);
+    }
+    return input;
+}
+
+// What goes into a channel's ring in ping-pong, null for silence
+const float* TelayAudioProcessor::getPingPongInput(float* const* channelData, int start, const float* mixedInput,
+    int channel) const {
+    if (mPingPongSource[(size_t)channel] < 0) {
+        return channelData[channel] + start;
+    }
+    return channel == mPingPongFirst ? mixedInput : nullptr;
+}
+
+int TelayAudioProcessor::getPingPongSource(int channel) const {
+    const int source = mPingPongSource[(size_t)channel];
+    return source >= 0 ? source : channel;
+}
+
+int TelayAudioProcessor::maxChunkForDelay(double minDelayInSamples, Interpolation kernel) {
+    // the kernel's newest tap has to be older than the chunk
+    return juce::jmax(1, (int)minDelayInSamples - DelayLine::getLookahead(kernel));
+}
+
+int TelayAudioProcessor::getMaxChunk(int type, Interpolation kernel, double engineRate, float shortestDelayTime) const {
+    // the modulated times are shortened when oversampled, see computeModulatedTimes()
+    const double lagCorrection = engineRate / mSampleRate - 1;
+
+    switch (type) {
+    case typeChorus:
+        return maxChunkForDelay(engineRate * 0.005f - lagCorrection, kernel);
+    case typeFlanger:
+        return maxChunkForDelay(engineRate * 0.001f - lagCorrection, kernel);
+    case typeMultiTap:
+        return maxChunkForDelay(mMultiTap.getShortestDelay(), kernel);
+    default:
+        // wow and flutter can pull the read head closer
+        return maxChunkForDelay(mSampleRate * shortestDelayTime - mFeedbackChain.getMaxModulation(), kernel);
+    }
+}
+
+bool TelayAudioProcessor::isDelayType(int type) {
+    return type == typeDelay || type == typePingPong || type == typeRhythm;
+}
+
+float TelayAudioProcessor::updateSyncedTime(int division, int numSamples, float maxDelayTime) {
+    // tempo from the host, 120 when there is none
+    double bpm = 120.0;
+    if (auto* hostPlayHead = getPlayHead()) {
+        if (auto position = hostPlayHead->getPosition()) {
+            bpm = position->getBpm().orFallback(bpm);
+        }
+    }
+
+    if (juce::exactlyEqual(bpm, mTempoBpm) && division == mDivision) {
+        return mSyncedTime;
+    }
+
+    const bool tempoChanged = mTempoBpm > 0 && division == mDivision;
+    mTempoBpm = bpm;
+    mDivision = division;
+
+    const int note = juce::jlimit(0, numNoteValues - 1, division / 3);
+    const float beats = noteBeats[note] * feelFactors[division % 3];
+    mSyncedTime = juce::jlimit(0.01f, maxDelayTime, (float)(60.0 / bpm) * beats);
+
+    // The host only reports tempo once per block, so a tempo ramp is followed by
+    // sliding the time linearly across the block. A new division glides or
+    // crossfades like the Rate knob does.
+    if (tempoChanged && juce::exactlyEqual(mFadeTime, mTimeSmoothed)) {
+        mTempoRampSamples = numSamples;
+        mTempoRampStep = (mSyncedTime - mTimeSmoothed) / numSamples;
+    }
+    else {
+        mTempoRampSamples = 0;
+    }
+
+    return mSyncedTime;
+}
+
+bool TelayAudioProcessor::computeDelayTimes(float* delays, int numSamples, const BlockParameters& blockParams, int timeMode) {
+    const float targetTime = blockParams.delayTime;
+
+    if (mTempoRampSamples > 0) {
+        float time = mTimeSmoothed;
+        const int rampSamples = juce::jmin(numSamples, mTempoRampSamples);
+
+        for (int sample = 0; sample < numSamples; sample++) {
+            if (sample < rampSamples) {
+                time += mTempoRampStep;
+            }
+            delays[sample] = (float)(mSampleRate * time);
         }
 
-        // Record Feedback
-        mFeedbackLeft = outSamples[0] * *mFeedbackParameter;
-        mFeedbackRight = outSamples[1] * *mFeedbackParameter;
+        // land exactly on the new time at the end of the block
+        mTempoRampSamples -= rampSamples;
+        if (mTempoRampSamples == 0) {
+            time = targetTime;
+        }
+        mTimeSmoothed = time;
+        mFadeTime = time;
+        return false;
+    }
 
-        // mix dry/wet ratio of incoming sample with delayed sample
-        float leftOutSample = buffer.getSample(0, sample) * (1 - *mDryWetParameter) + outSamples[0] * *mDryWetParameter;
-        float rightOutSample = buffer.getSample(1, sample) * (1 - *mDryWetParameter) + outSamples[1] * *mDryWetParameter;
+    // a running crossfade finishes before the time can move again
+    if (juce::exactlyEqual(mFadeTime, mTimeSmoothed) && ! juce::exactlyEqual(mTimeSmoothed, targetTime)) {
+        if (timeMode == timeModeCrossfade) {
+            mFadeTime = targetTime;
+            mFadeSamples = 0;
+        }
+        else {
+            float timeSmoothed = mTimeSmoothed;
+
+            for (int sample = 0; sample < numSamples; sample++) {
+                // Smooth user input to prevent clicks and irregularities. Close to the
+                // target the step rounds away in float, from there it creeps one ulp at a time.
+                const float next = timeSmoothed - 0.0001 * (timeSmoothed - targetTime);
+                timeSmoothed = ! juce::exactlyEqual(next, timeSmoothed) ? next : std::nextafter(timeSmoothed, targetTime);
+
+                // and it snaps once it is within a thousandth of a sample
+                if (std::abs(timeSmoothed - targetTime) * mSampleRate < 0.001) {
+                    timeSmoothed = targetTime;
+                }
+
+                // Final delay time in samples, the fraction goes to the interpolator
+                delays[sample] = (float)(mSampleRate * timeSmoothed);
+            }
+
+            mTimeSmoothed = timeSmoothed;
+            mFadeTime = timeSmoothed;
+            return false;
+        }
+    }
+
+    // the current tap holds still for the whole chunk
+    juce::FloatVectorOperations::fill(delays, (float)(mSampleRate * mTimeSmoothed), numSamples);
+    return true;
+}
 
-        // sample leaves
-        buffer.setSample(0, sample, leftOutSample);
-        buffer.setSample(1, sample, rightOutSample);
+void TelayAudioProcessor::readTap(Interpolation kernel, int channel, const float* delays, bool isStatic, float* output,
+    int numSamples, float& allpassState) {
+    // a static whole-sample delay needs no interpolation at all
+    if (isStatic && juce::exactlyEqual(delays[0], (float)(int)delays[0])) {
+        mDelayLine.readInteger(channel, (int)delays[0], output, numSamples);
+    }
+    else {
+        mDelayLine.read(kernel, channel, delays, output, numSamples, allpassState);
     }
 }
 
-float* TelayAudioProcessor::lfoSamplesOut(float* leftChannel, float* rightChannel, int sample) {
+void TelayAudioProcessor::crossfadeTap(Interpolation kernel, int channel, float* wet, int numSamples,
+    const float* wowFlutter, float maxDelayInSamples) {
+    float* fadeDelays = mScratch.getChannelPointer(scratchFadeDelay);
+    float* faded = mScratch.getChannelPointer(scratchCrossfade);
+    juce::FloatVectorOperations::fill(fadeDelays, (float)(mSampleRate * mFadeTime), numSamples);
+
+    // the new tap is on the same tape, so it wobbles along with the current one
+    const bool isStatic = wowFlutter == nullptr;
+    if (! isStatic) {
+        addWowFlutter(fadeDelays, wowFlutter, numSamples, maxDelayInSamples);
+    }
+
+    // the allpass is never used in delay mode, its state doesn't matter here
+    float allpassState = 0.0;
+    readTap(kernel, channel, fadeDelays, isStatic, faded, numSamples, allpassState);
 
-    // lfoOutRight is offset by mPhaseOffsetParameter
-    float lfoPhaseRight = mLFOPhase + *mPhaseOffsetParameter;
-    // wrap phase between 0 and 1
-    if (lfoPhaseRight > 1) {
-        lfoPhaseRight -= 1;
+    // linear fade from the current tap to the new one
+    for (int sample = 0; sample < numSamples; sample++) {
+        const float gain = juce::jmin(1.f, (float)(mFadeSamples + sample + 1) / (float)mCrossfadeLength);
+        wet[sample] += gain * (faded[sample] - wet[sample]);
     }
+}
 
-    // lfoOut --> delayTime
-    float lfoOutLeft = sin(2 * juce::float_Pi * mLFOPhase);
-    float lfoOutRight = sin(2 * juce::float_Pi * lfoPhaseRight);
+void TelayAudioProcessor::addWowFlutter(float* delays, const float* offsets, int numSamples, float maxDelayInSamples) {
+    // the offsets swing both ways, but the read head can't go further back than the rings hold
+    juce::FloatVectorOperations::add(delays, offsets, numSamples);
+    juce::FloatVectorOperations::min(delays, delays, maxDelayInSamples, numSamples);
+}
 
-    // Scale by depth parameter
-    lfoOutLeft *= *mDepthParameter;
-    lfoOutRight *= *mDepthParameter;
+float TelayAudioProcessor::getVoiceRateScale(int voice, int numVoices) {
+    // the voices' rates are spread evenly either side of the Rate knob
+    return numVoices > 1 ? 1 + voiceDetune * (2.0f * voice / (numVoices - 1) - 1) : 1.0f;
+}
 
-    float lfoOutMappedLeft = 0.0;
-    float lfoOutMappedRight = 0.0;
+void TelayAudioProcessor::addChorusVoices(Interpolation kernel, int numChannels, int numSamples, int numVoices,
+    const ChunkParameters& chunkParams, double sampleRate) {
+    // The voices take turns with the delay scratch, each one's times for every
+    // channel and then its reads, so the scratch needed doesn't grow with them.
+    // Every read is one run through the ring that the kernel vectorises across samples.
+    float* voiceOutput = mScratch.getChannelPointer(scratchCrossfade);
+
+    for (int voice = 1; voice < numVoices; voice++) {
+        // the voices also start spread evenly round the cycle
+        computeModulatedTimes(mLfos[voice], getVoiceRateScale(voice, numVoices), (float)voice / numVoices,
+            numChannels, numSamples, chunkParams, sampleRate, 0.005f, 0.03f);
+
+        for (int channel = 0; channel < numChannels; channel++) {
+            // chorus never reads through the allpass, its state doesn't matter here
+            float allpassState = 0.0f;
+            readTap(kernel, channel, mChannelDelays[(size_t)channel], false, voiceOutput, numSamples, allpassState);
+            juce::FloatVectorOperations::add(getWetScratch(channel), voiceOutput, numSamples);
+        }
+    }
 
-    if (*mTypeParameter == 1) {
-        lfoOutMappedLeft = juce::jmap(lfoOutLeft, -1.f, 1.f, 0.005f, 0.03f);
-        lfoOutMappedRight = juce::jmap(lfoOutRight, -1.f, 1.f, 0.005f, 0.03f);
+    // The feedback loop gets the voices' average. At low frequencies they are
+    // still in phase, so anything louder could take the loop gain past one.
+    for (int channel = 0; channel < numChannels; channel++) {
+        juce::FloatVectorOperations::multiply(getWetScratch(channel), 1.0f / numVoices, numSamples);
+    }
+}
+
+void TelayAudioProcessor::computeModulatedTimes(Lfo& lfo, float rateScale, float voicePhase, int numChannels,
+    int numSamples, const ChunkParameters& chunkParams, double sampleRate, float minDelayTime, float maxDelayTime) {
+    // the channels are spread evenly from no offset to the full phase offset, so stereo
+    // keeps left at 0 and right at the offset
+    for (int channel = 0; channel < numChannels; channel++) {
+        const float offset = voicePhase + (numChannels > 1 ? chunkParams.phaseOffset * channel / (numChannels - 1) : 0.f);
+        mLfoPhaseOffsets[(size_t)channel] = offset > 1 ? offset - 1 : offset;
+    }
+    const bool isFirstLfo = &lfo == &mLfos[0];
+
+    // worked out like the steady increment below, sample by sample
+    if (chunkParams.rateRamp != nullptr) {
+        float* increments = mScratch.getChannelPointer(scratchLfoIncrement);
+        for (int sample = 0; sample < numSamples; sample++) {
+            increments[sample] = (float)(chunkParams.rateRamp[sample] * rateScale / sampleRate);
+        }
+        lfo.process(mChannelDelays, mLfoPhaseOffsets, numChannels, numSamples, increments);
     }
     else {
-        lfoOutMappedLeft = juce::jmap(lfoOutLeft, -1.f, 1.f, 0.001f, 0.005f);
-        lfoOutMappedRight = juce::jmap(lfoOutRight, -1.f, 1.f, 0.001f, 0.005f);
+        lfo.process(mChannelDelays, mLfoPhaseOffsets, numChannels, numSamples, chunkParams.rate * rateScale / sampleRate);
+    }
+    if (isFirstLfo) {
+        mLfoValue = mChannelDelays[0][numSamples - 1];
     }
 
-    float delayTimeSamplesRight = getSampleRate() * lfoOutMappedRight;
-    float delayTimeSamplesLeft = getSampleRate() * lfoOutMappedLeft;
+    // map -1..1 onto the sweep range in samples, a plain multiply-add the compiler can vectorise
+    const float range = (float)(sampleRate * (maxDelayTime - minDelayTime) * 0.5);
+    // A delay of one sample reads the newest sample, so delays count one more than
+    // the lag. Oversampled, that one is a shorter time, which is made up here so
+    // the lag doesn't change with the factor.
+    const float offset = (float)(sampleRate * (maxDelayTime + minDelayTime) * 0.5 - (sampleRate / mSampleRate - 1));
+
+    for (int channel = 0; channel < numChannels; channel++) {
+        float* delays = mChannelDelays[(size_t)channel];
+
+        if (chunkParams.depthRamp != nullptr) {
+            const float* depth = chunkParams.depthRamp;
+            for (int sample = 0; sample < numSamples; sample++) {
+                delays[sample] = delays[sample] * (range * depth[sample]) + offset;
+            }
+        }
+        else {
+            const float scale = range * chunkParams.depth;
+            for (int sample = 0; sample < numSamples; sample++) {
+                delays[sample] = delays[sample] * scale + offset;
+            }
+        }
+    }
+}
 
-    // iterate mLFOPhase
-    mLFOPhase += *mRateParameter / getSampleRate();
+float TelayAudioProcessor::writeWithFeedback(int channel, const float* input, const float* wet, float& feedbackState,
+    int numSamples, const ChunkParameters& chunkParams) {
+    float* toWrite = mScratch.getChannelPointer(scratchWrite);
 
-    // wrap phase between 0 and 1
-    if (mLFOPhase > 1) {
-        mLFOPhase -= 1;
+    // the feedback goes through the loop's filters and saturator on its way back in
+    if (mFeedbackChain.isActive()) {
+        float* shaped = mScratch.getChannelPointer(scratchFeedback);
+        juce::FloatVectorOperations::copy(shaped, wet, numSamples);
+        mFeedbackChain.process(channel, shaped, numSamples);
+        wet = shaped;
     }
 
-    // calculate and wrap delayHeadLeft
-    float delayReadHeadLeft = mCircularBufferWriteHead - delayTimeSamplesLeft;
-    if (delayReadHeadLeft < 0) {
-        delayReadHeadLeft += mCircularBufferLength;
+    // sample i picks up the feedback of wet sample i - 1, the first one the state from the last chunk.
+    // A null input writes the feedback alone.
+    if (input != nullptr) {
+        juce::FloatVectorOperations::copy(toWrite, input, numSamples);
+    }
+    else {
+        juce::FloatVectorOperations::clear(toWrite, numSamples);
+    }
+    toWrite[0] += feedbackState;
+    if (chunkParams.feedbackRamp != nullptr) {
+        juce::FloatVectorOperations::addWithMultiply(toWrite + 1, wet, chunkParams.feedbackRamp, numSamples - 1);
+        feedbackState = wet[numSamples - 1] * chunkParams.feedbackRamp[numSamples - 1];
+    }
+    else {
+        juce::FloatVectorOperations::addWithMultiply(toWrite + 1, wet, chunkParams.feedback, numSamples - 1);
+        feedbackState = wet[numSamples - 1] * chunkParams.feedback;
     }
 
-    // Floor of leftDelay, fract leftDelay, one up for interpolation
-    int readHeadLeft_x = (int)delayReadHeadLeft;
-    float readHeadFloatLeft = delayReadHeadLeft - readHeadLeft_x;
-    int readHeadLeft_x1 = (readHeadLeft_x + 1) % mCircularBufferLength;
+    mDelayLine.write(channel, toWrite, numSamples);
 
-    //calculate and wrap delayHeadRight
-    float delayReadHeadRight = mCircularBufferWriteHead - delayTimeSamplesRight;
-    if (delayReadHeadRight < 0) {
-        delayReadHeadRight += mCircularBufferLength;
+    mSignals.addFeedback(wet, numSamples, chunkParams.feedback);
+    if (channel == 0) {
+        mSignals.addScope(toWrite, numSamples);
     }
 
-    // Floor of rigfhtDelay, fract rightDelay, one up for interpolation
-    int readHeadRight_x = (int)delayReadHeadRight;
-    float readHeadFloatRight = delayReadHeadRight - readHeadRight_x;
-    int readHeadRight_x1 = (readHeadRight_x + 1) % mCircularBufferLength;
+    // the peak written, for the silence detection
+    const auto range = juce::FloatVectorOperations::findMinAndMax(toWrite, numSamples);
+    return juce::jmax(-range.getStart(), range.getEnd());
+}
 
-    // interpolated samples
-    float delay_sample_left = lin_interp(mCircularBufferLeft[readHeadLeft_x], mCircularBufferLeft[readHeadLeft_x1], readHeadFloatLeft);
-    float delay_sample_right = lin_interp(mCircularBufferRight[readHeadRight_x], mCircularBufferRight[readHeadRight_x1], readHeadFloatRight);
-    return new float[2]{ delay_sample_left, delay_sample_right };
+void TelayAudioProcessor::mixDryWet(float* dry, const float* wet, int numSamples, const ChunkParameters& chunkParams) {
+    // the ramp does the same sums as the steady mix, so it doesn't matter which chunk a ramp ends in
+    if (chunkParams.dryWetRamp != nullptr) {
+        const float* mix = chunkParams.dryWetRamp;
+        for (int sample = 0; sample < numSamples; sample++) {
+            dry[sample] = dry[sample] * (1 - mix[sample]) + wet[sample] * mix[sample];
+        }
+    }
+    else {
+        juce::FloatVectorOperations::multiply(dry, 1 - chunkParams.dryWet, numSamples);
+        juce::FloatVectorOperations::addWithMultiply(dry, wet, chunkParams.dryWet, numSamples);
+    }
 }
 
-float* TelayAudioProcessor::delaySamplesOut(float* leftChannel, float* rightChannel, int sample) {
-    // Smooth user input to prevent clicks and irregularities
-    mTimeSmoothed = mTimeSmoothed - 0.0001 * (mTimeSmoothed - (*mRateParameter / 10));
+bool TelayAudioProcessor::isSilent(const float* const* channelData, int numChannels, int numSamples) {
+    for (int channel = 0; channel < numChannels; channel++) {
+        const auto range = juce::FloatVectorOperations::findMinAndMax(channelData[channel], numSamples);
+        if (juce::jmax(-range.getStart(), range.getEnd()) >= silenceThreshold) {
+            return false;
+        }
+    }
+    return true;
+}
 
-    // Final delay time in samples
-    mDelayTimeInSamples = getSampleRate() * mTimeSmoothed;
+void TelayAudioProcessor::processSilentBlock(float* const* channelData, int numChannels, int numSamples,
+    const BlockParameters& blockParams) {
+    // What is left in the rings is below the threshold, so it is dropped rather
+    // than played out, and the next loud block starts from a clean engine. The
+    // reset doesn't touch the memory, it is cleared as the write head moves on.
+    if (! mIsSilent) {
+        mDelayLine.reset();
+        juce::FloatVectorOperations::clear(mFeedbackState.get(), mNumChannels);
+        juce::FloatVectorOperations::clear(mAllpassState.get(), mNumChannels);
+        mMultiTap.reset();
+        mFeedbackChain.reset();
+        mIsSilent = true;
+    }
 
-    // ReadHeadIndex with delay
-    mDelayReadHead = mCircularBufferWriteHead - mDelayTimeInSamples;
+    // there is nothing left of the old type to fade out
+    mOutgoingType = -1;
+    mTransitionSamples = 0;
+
+    // a ramp or glide over silence can't be heard, so everything lands on its target
+    mDryWetSmoothed.reset(blockParams.dryWet);
+    mFeedbackSmoothed.reset(blockParams.feedback);
+    mDepthSmoothed.reset(blockParams.depth);
+    mRateSmoothed.reset(blockParams.rate);
+    mPhaseOffsetSmoothed.reset(blockParams.phaseOffset);
+    mPhaseOffset = blockParams.phaseOffset;
+    mPhaseOffsetCountdown = 0;
+    mTimeSmoothed = blockParams.delayTime;
+    mFadeTime = mTimeSmoothed;
+    mFadeSamples = 0;
+    mTempoRampSamples = 0;
+
+    mSignals.addScope(nullptr, numSamples);
+
+    // the wet half is silence, the dry half is what came in
+    for (int channel = 0; channel < numChannels; channel++) {
+        juce::FloatVectorOperations::multiply(channelData[channel], 1 - blockParams.dryWet, numSamples);
+    }
+}
 
-    // Wrap if less than 0
-    if (mDelayReadHead < 0) {
-        mDelayReadHead += mCircularBufferLength;
+float TelayAudioProcessor::getLongestDelay(int type, float delayTime) const {
+    // the longest delay an echo can come back after, in seconds
+    switch (type) {
+    case typeChorus:
+        return 0.03f;
+    case typeFlanger:
+        return 0.005f;
+    case typeMultiTap:
+        return (float)(mMultiTap.getLongestDelay() / mSampleRate);
+    default:
+        return juce::jmax(delayTime, mTimeSmoothed, mFadeTime);
     }
+}
 
-    // floor of mDelayReadHead
-    int readHead_x = (int)mDelayReadHead;
+void TelayAudioProcessor::updateTailLength(int type, float delayTime, float feedback) {
+    const float longestDelay = getLongestDelay(type, delayTime);
 
-    // fract of mDelayReadHead
-    float readHeadFloat = mDelayReadHead - readHead_x;
+    // the trips round the feedback loop it takes to fade below the silence threshold
+    int repeats = 0;
+    if (feedback > 0) {
+        repeats = (int)std::ceil(std::log(silenceThreshold) / std::log(feedback));
+    }
 
-    // one sample up from mDelayReadHead for interpolation
-    int readHead_x1 = (readHead_x + 1) % mCircularBufferLength;
+    mTailLength = longestDelay * (repeats + 1);
 
-    // interpolated samples
-    float delay_sample_left = lin_interp(mCircularBufferLeft[readHead_x], mCircularBufferLeft[readHead_x1], readHeadFloat);
-    float delay_sample_right = lin_interp(mCircularBufferRight[readHead_x], mCircularBufferRight[readHead_x1], readHeadFloat);
-    return new float[2]{ delay_sample_left, delay_sample_right };
+    // What the engine reads, the outgoing type's too while it fades, only goes
+    // back this far. The count is in engine samples.
+    float longestRead = longestDelay;
+    if (mOutgoingType >= 0) {
+        longestRead = juce::jmax(longestRead, getLongestDelay(mOutgoingType, mOutgoingDelayTime));
+    }
+    const auto* oversampler = getOversamplerFor(type);
+    const double engineRate = mSampleRate * (oversampler != nullptr ? (double)oversampler->getOversamplingFactor() : 1.0);
+    mQuietSamplesNeeded = juce::jmin((int)std::ceil((longestRead + silenceMargin) * engineRate), mDelayLine.getCapacity());
 }
 
 //==============================================================================
@@ -351,22 +1478,15 @@ juce::AudioProcessorEditor* TelayAudioProcessor::createEditor()
 // Save plugin state when saving a DAW session
 void TelayAudioProcessor::getStateInformation(juce::MemoryBlock& destData)
 {
-    auto state = params.copyState();
-    std::unique_ptr<juce::XmlElement> xml(state.createXml());
-    copyXmlToBinary(*xml, destData);
-    parameterPrint();
+    mPresets.writeState(destData);
 }
 
-// Load plugin state when opening a saved DAW session
+// Load plugin state when opening a saved DAW session, binary or the older XML
 void TelayAudioProcessor::setStateInformation(const void* data, int sizeInBytes)
 {
-    std::unique_ptr<juce::XmlElement> xmlState(getXmlFromBinary(data, sizeInBytes));
-
-    if (xmlState.get() != nullptr)
-        if (xmlState->hasTagName(params.state.getType()))
-            params.replaceState(juce::ValueTree::fromXml(*xmlState));
-
-    parameterPrint();
+    if (mPresets.readState(data, sizeInBytes)) {
+        updateHostDisplay(juce::AudioProcessorListener::ChangeDetails().withProgramChanged(true));
+    }
 }
 
 //==============================================================================
@@ -375,16 +1495,3 @@ juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
 {
     return new TelayAudioProcessor();
 }
-
-float TelayAudioProcessor::lin_interp(float inSampleX, float inSampleY, float inFloatPhase) {
-    return (1 - inFloatPhase) * inSampleX + inFloatPhase * inSampleY;
-}
-
-void TelayAudioProcessor::parameterPrint() {
-    DBG("DRY/WET: " << *mDryWetParameter);
-    DBG("FEEDBACK: " << *mFeedbackParameter);
-    DBG("DEPTH: " << *mDepthParameter);
-    DBG("RATE: " << *mRateParameter);
-    DBG("PHASEOFFSET: " << *mPhaseOffsetParameter);
-    DBG("Type: " << *mTypeParameter);
-}
\ No newline at end of file
@@ -9,8 +9,58 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "DelayLine.h"
+#include "FeedbackChain.h"
+#include "Lfo.h"
+#include "MultiTap.h"
+#include "PerformanceMonitor.h"
+#include "PresetBank.h"
+#include "SignalMonitor.h"
+#include "SmoothedParameter.h"
 
-#define MAX_DELAY_TIME 2
+// the longest maximum delay the user can pick, and the default one, in seconds
+#define MAX_DELAY_TIME 60
+#define DEFAULT_MAX_DELAY_TIME 2
+
+// chorus voices per channel
+#define MAX_CHORUS_VOICES 8
+
+// Parameter values snapshotted once at the start of each block, or part of one split at a controller
+struct BlockParameters
+{
+    float dryWet;
+    float feedback;
+    float depth;
+    float rate;
+    float phaseOffset;
+    float delayTime;
+    float maxDelayTime;
+    float lowCut;
+    float highCut;
+    float drive;
+    float wowFlutter;
+    int type;
+    int timeMode;
+    int numVoices;
+    Interpolation kernel;
+    // the kernel of the mode being faded out, while a type change is under way
+    Interpolation outgoingKernel;
+};
+
+// Smoothed parameter values for one chunk. A ramp holds one value per sample,
+// or is null while the parameter holds still and the plain value applies.
+struct ChunkParameters
+{
+    const float* dryWetRamp;
+    const float* feedbackRamp;
+    const float* depthRamp;
+    const float* rateRamp;
+    float dryWet;
+    float feedback;
+    float depth;
+    float rate;
+    float phaseOffset;
+};
 
 //==============================================================================
 /**
@@ -19,8 +69,27 @@ class TelayAudioProcessor : public juce::AudioProcessor
 #if JucePlugin_Enable_ARA
     , public juce::AudioProcessorARAExtension
 #endif
+    , private juce::Timer
 {
 public:
+    enum EffectType
+    {
+        typeDelay = 0,
+        typeChorus,
+        typeFlanger,
+        typeMultiTap,
+        typePingPong,
+        typeRhythm,
+        numEffectTypes
+    };
+
+    // How delay mode follows a change of delay time
+    enum TimeMode
+    {
+        timeModeGlide = 0,  // tape style, the read head slides and the pitch bends
+        timeModeCrossfade   // a second tap jumps to the new time and is faded in
+    };
+
     //==============================================================================
     TelayAudioProcessor();
     virtual ~TelayAudioProcessor() override;
@@ -58,10 +127,59 @@ public:
     void getStateInformation(juce::MemoryBlock& destData) override;
     void setStateInformation(const void* data, int sizeInBytes) override;
 
-    float lin_interp(float inSampleX, float inSampleY, float inFloatPhase);
-    float* delaySamplesOut(float* leftChannel, float* rightChannel, int sample);
-    float* lfoSamplesOut(float* leftChannel, float* rightChannel, int sample);
-    void parameterPrint();
+    static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+
+    // what the Type parameter shows for each EffectType
+    static juce::String getTypeName(int type);
+
+    // stores the current settings as a user preset and selects it
+    int saveUserPreset(const juce::String& name);
+    bool isUserPreset(int index) const noexcept { return mPresets.isUserPreset(index); }
+
+    // per-block timing, read from the message thread
+    PerformanceMonitor& getPerformanceMonitor() noexcept { return mPerformance; }
+
+    // levels, LFO and delay line scope for the editor
+    SignalMonitor& getSignalMonitor() noexcept { return mSignals; }
+
+    void processSubBlock(float* const* blockData, int numChannels, int start, int numSamples, int blockSamples,
+        PerformanceMonitor::ScopedBlock& performanceBlock);
+    void processChunks(float* const* channelData, int numChannels, int numSamples, const BlockParameters& blockParams,
+        double engineRate, bool wetOnly);
+    void processOversampled(juce::dsp::Oversampling<float>* oversampler, float* const* channelData, int numChannels,
+        int start, int numSamples, const BlockParameters& blockParams);
+    juce::dsp::Oversampling<float>* getOversamplerFor(int type) const;
+    void setOversampler(juce::dsp::Oversampling<float>* oversampler);
+    void timerCallback() override;
+    static int maxChunkForDelay(double minDelayInSamples, Interpolation kernel);
+    int getMaxChunk(int type, Interpolation kernel, double engineRate, float shortestDelayTime) const;
+    static bool isDelayType(int type);
+    void renderWet(int type, Interpolation kernel, int numChannels, int numSamples, const BlockParameters& blockParams,
+        const ChunkParameters& chunkParams, double engineRate, const float* wowFlutter, bool isOutgoing);
+    float writeTransition(float* const* channelData, int start, int numChannels, int numSamples, int type,
+        const ChunkParameters& chunkParams);
+    const float* mixPingPongInput(float* const* channelData, int start, int numChannels, int numSamples);
+    const float* getPingPongInput(float* const* channelData, int start, const float* mixedInput, int channel) const;
+    int getPingPongSource(int channel) const;
+    float updateSyncedTime(int division, int numSamples, float maxDelayTime);
+    bool computeDelayTimes(float* delays, int numSamples, const BlockParameters& blockParams, int timeMode);
+    void computeModulatedTimes(Lfo& lfo, float rateScale, float voicePhase, int numChannels, int numSamples,
+        const ChunkParameters& chunkParams, double sampleRate, float minDelayTime, float maxDelayTime);
+    void addChorusVoices(Interpolation kernel, int numChannels, int numSamples, int numVoices,
+        const ChunkParameters& chunkParams, double sampleRate);
+    static float getVoiceRateScale(int voice, int numVoices);
+    float writeWithFeedback(int channel, const float* input, const float* wet, float& feedbackState,
+        int numSamples, const ChunkParameters& chunkParams);
+    void readTap(Interpolation kernel, int channel, const float* delays, bool isStatic, float* output,
+        int numSamples, float& allpassState);
+    void crossfadeTap(Interpolation kernel, int channel, float* wet, int numSamples, const float* wowFlutter,
+        float maxDelayInSamples);
+    static void addWowFlutter(float* delays, const float* offsets, int numSamples, float maxDelayInSamples);
+    static void mixDryWet(float* dry, const float* wet, int numSamples, const ChunkParameters& chunkParams);
+    static bool isSilent(const float* const* channelData, int numChannels, int numSamples);
+    void processSilentBlock(float* const* channelData, int numChannels, int numSamples, const BlockParameters& blockParams);
+    float getLongestDelay(int type, float delayTime) const;
+    void updateTailLength(int type, float delayTime, float feedback);
 
 private:
     //==============================================================================
@@ -71,27 +189,172 @@ private:
     // Parameter Decleration
     juce::AudioProcessorValueTreeState params;
 
+    // factory and user presets, and the saved state
+    PresetBank mPresets;
+
     juce::AudioParameterFloat* mDryWetParameter;
     juce::AudioParameterFloat* mDepthParameter;
     juce::AudioParameterFloat* mRateParameter;
     juce::AudioParameterFloat* mPhaseOffsetParameter;
     juce::AudioParameterFloat* mFeedbackParameter;
+    juce::AudioParameterFloat* mLowCutParameter;
+    juce::AudioParameterFloat* mHighCutParameter;
+    juce::AudioParameterFloat* mDriveParameter;
+    juce::AudioParameterFloat* mWowFlutterParameter;
 
     juce::AudioParameterInt* mTypeParameter;
+    juce::AudioParameterInt* mShapeParameter;
+    juce::AudioParameterInt* mQualityParameter;
+    juce::AudioParameterInt* mTimeModeParameter;
+    juce::AudioParameterInt* mDivisionParameter;
+    juce::AudioParameterInt* mMaxDelayParameter;
+    juce::AudioParameterInt* mOversamplingParameter;
+
+    juce::AudioParameterInt* mNumVoicesParameter;
+    juce::AudioParameterInt* mNumTapsParameter;
+    juce::AudioParameterFloat* mTapTimeParameters[MultiTap::maxTaps];
+    juce::AudioParameterFloat* mTapGainParameters[MultiTap::maxTaps];
+    juce::AudioParameterFloat* mTapPanParameters[MultiTap::maxTaps];
+    juce::AudioParameterFloat* mTapToneParameters[MultiTap::maxTaps];
+
+    // the parameter each MIDI controller number moves, or null, and whether the
+    // audio thread moved it since the host last heard
+    juce::RangedAudioParameter* mControllerParameters[128];
+    std::atomic<bool> mControllerMoved[128];
 
-    // Circular Buffers for delay
-    std::unique_ptr<float[]> mCircularBufferLeft;
-    std::unique_ptr<float[]> mCircularBufferRight;
-    int mCircularBufferWriteHead;
-    int mCircularBufferLength;
+    // Circular Buffer for delay, one ring per channel in one allocation
+    DelayLine mDelayLine;
+    int mNumChannels;
+
+    // the maximum delay the rings are sized for, in seconds
+    int mMaxDelay;
 
-    int mDelayTimeInSamples;
     float mTimeSmoothed;
 
-    // Lfo stuff
-    float mLFOPhase;
+    // delay time of the tap being faded in, equal to mTimeSmoothed when no fade runs,
+    // and how far the fade is, counted in samples so it is the same however it is chunked
+    float mFadeTime;
+    int mFadeSamples;
+    int mCrossfadeLength;
+
+    // tempo sync, the synced time is only worked out again when tempo or division change
+    double mTempoBpm;
+    int mDivision;
+    float mSyncedTime;
+    int mTempoRampSamples;
+    float mTempoRampStep;
+
+    // zipper-free versions of the continuous parameters
+    SmoothedParameter mDryWetSmoothed;
+    SmoothedParameter mFeedbackSmoothed;
+    SmoothedParameter mDepthSmoothed;
+    SmoothedParameter mRateSmoothed;
+    SmoothedParameter mPhaseOffsetSmoothed;
+    // the phase offset in use, and engine samples until it next steps while gliding
+    float mPhaseOffset;
+    int mPhaseOffsetCountdown;
+
+    // Lfo stuff, one per chorus voice. Flanger and a single voice chorus use the first.
+    Lfo mLfos[MAX_CHORUS_VOICES];
+
+    // A change of type runs the old and new engines side by side for an equal-power
+    // crossfade. mEngineType is the one playing, or fading in, and mOutgoingType the
+    // one fading out, -1 when no change is under way. The outgoing one keeps a copy
+    // of the first LFO and, in the delay modes, holds the time it had. The fade's
+    // progress is counted in engine samples.
+    int mEngineType;
+    int mOutgoingType;
+    int mTransitionSamples;
+    float mOutgoingDelayTime;
+    Lfo mOutgoingLfo;
+
+    // read heads for the multi-tap mode, on the same delay line
+    MultiTap mMultiTap;
+
+    // filters and saturation in the feedback loop, wow and flutter on the delay modes' read time
+    FeedbackChain mFeedbackChain;
+
+    // per channel state, sized in prepareToPlay with room for mAllocatedChannels
+    juce::HeapBlock<float> mFeedbackState;
+    juce::HeapBlock<float> mAllpassState;
+    juce::HeapBlock<float> mLfoPhaseOffsets;
+    juce::HeapBlock<float*> mChannelDelays;
+    // Ping-pong's rotation: the speaker each one's repeats come from, or -1 for the
+    // channels left out of it (LFE, ambisonics), which echo on their own.
+    // The first speaker takes all the speakers' input.
+    juce::HeapBlock<int> mPingPongSource;
+    int mPingPongFirst;
+    int mAllocatedChannels;
+
+    double mSampleRate;
+
+    // 2x and 4x oversampling of the chorus and flanger read/feedback loop. The dry
+    // signal is delayed by the active one's latency so it lines up with the wet.
+    static constexpr int numOversamplers = 2;
+    std::unique_ptr<juce::dsp::Oversampling<float>> mOversamplers[numOversamplers];
+    juce::dsp::Oversampling<float>* mOversampler;
+    int mOversamplingBlockSize;
+    juce::HeapBlock<float*> mOversampledChannels;
+    // the host's channel pointers offset to the start of the sub-block being processed
+    juce::HeapBlock<float*> mSubBlockChannels;
+    juce::AudioBuffer<float> mDryDelay;
+
+    // latency of the active oversampler, passed on to the host from the message
+    // thread's timer once the audio thread flags a change
+    std::atomic<int> mLatency;
+    std::atomic<bool> mLatencyChanged;
+
+    // Samples in a row that went into the rings below the silence threshold. Once
+    // that is more than the longest delay in use can reach back, mQuietSamplesNeeded,
+    // and the input is silent, blocks skip the engine.
+    int mQuietSamples;
+    int mQuietSamplesNeeded;
+    bool mIsSilent;
+
+    // reported to the host, written on the audio thread
+    std::atomic<float> mTailLength;
+
+    PerformanceMonitor mPerformance;
+    SignalMonitor mSignals;
+
+    // the first LFO's last output, for the editor
+    float mLfoValue;
+
+    // Per-block scratch, allocated in prepareToPlay
+    enum ScratchChannel
+    {
+        scratchWrite = 0,
+        scratchLfoIncrement,
+        scratchCrossfade,
+        scratchFadeDelay,
+        scratchPingPongInput,
+        scratchFeedback,
+        scratchWowFlutter,
+        scratchTransitionFade,
+        scratchTransitionOut,
+        scratchTransitionIn,
+        scratchTransitionInput,
+        scratchTransitionFeedback,
+        scratchTapFade,
+        numSharedScratchChannels
+    };
+
+    // After the shared channels come a delay time and a wet channel per audio channel,
+    // then the outgoing engine's wet and feedback while the type changes
+    float* getDelayScratch(int channel) const noexcept {
+        return mScratch.getChannelPointer((size_t)(numSharedScratchChannels + channel));
+    }
+    float* getWetScratch(int channel) const noexcept {
+        return mScratch.getChannelPointer((size_t)(numSharedScratchChannels + mNumChannels + channel));
+    }
+    float* getOutgoingWetScratch(int channel) const noexcept {
+        return mScratch.getChannelPointer((size_t)(numSharedScratchChannels + 2 * mNumChannels + channel));
+    }
+    float* getOutgoingFeedbackScratch(int channel) const noexcept {
+        return mScratch.getChannelPointer((size_t)(numSharedScratchChannels + 3 * mNumChannels + channel));
+    }
 
-    float mDelayReadHead;
-    float mFeedbackLeft;
-    float mFeedbackRight;
+    juce::HeapBlock<char> mScratchMemory;
+    juce::dsp::AudioBlock<float> mScratchAllocation;
+    juce::dsp::AudioBlock<float> mScratch;
 };
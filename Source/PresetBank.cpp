@@ -0,0 +1,310 @@
+/*
+  ==============================================================================
+
+    PresetBank.cpp
+
+  ==============================================================================
+*/
+
+#include "PresetBank.h"
+
+// sanity limits for reading a state back
+static const int maxStoredParameters = 4096;
+static const int maxStoredPresets = 4096;
+
+PresetBank::PresetBank(juce::AudioProcessorValueTreeState& state)
+    : mState(state)
+{
+    // every parameter the processor has, in its own order
+    for (auto* parameter : state.processor.getParameters()) {
+        auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameter);
+        jassert(ranged != nullptr);
+        mParameters.add(ranged);
+    }
+
+    mCurrentPreset = 0;
+    mAudioRunning = false;
+    mHostNeedsUpdate = false;
+    mHandoverSlot = 0;
+    mWriteSlot = 1;
+    mReadSlot = 2;
+    mSlotValues.allocate((size_t)(numSlots * mParameters.size()), true);
+}
+
+void PresetBank::addFactoryPreset(const juce::String& name, std::initializer_list<std::pair<std::string, float>> values)
+{
+    Preset preset = { name, getDefaults() };
+    for (const auto& value : values) {
+        auto* parameter = mState.getParameter(value.first);
+        if (parameter == nullptr) {
+            jassertfalse; // no such parameter
+            continue;
+        }
+        preset.values[(size_t)parameter->getParameterIndex()] = parameter->convertTo0to1(value.second);
+    }
+    mFactoryPresets.push_back(preset);
+}
+
+std::vector<float> PresetBank::getDefaults() const
+{
+    std::vector<float> values((size_t)mParameters.size());
+    for (int i = 0; i < mParameters.size(); i++) {
+        values[(size_t)i] = mParameters[i]->getDefaultValue();
+    }
+    return values;
+}
+
+std::vector<float> PresetBank::getCurrentValues() const
+{
+    std::vector<float> values((size_t)mParameters.size());
+    for (int i = 0; i < mParameters.size(); i++) {
+        values[(size_t)i] = mParameters[i]->getValue();
+    }
+    return values;
+}
+
+//==============================================================================
+juce::String PresetBank::getName(int index) const
+{
+    if (index >= 0 && index < (int)mFactoryPresets.size()) {
+        return mFactoryPresets[(size_t)index].name;
+    }
+    if (isUserPreset(index)) {
+        return mUserPresets[(size_t)(index - (int)mFactoryPresets.size())].name;
+    }
+    return {};
+}
+
+bool PresetBank::isUserPreset(int index) const noexcept
+{
+    return index >= (int)mFactoryPresets.size() && index < getNumPresets();
+}
+
+void PresetBank::select(int index)
+{
+    if (index < 0 || index >= getNumPresets()) {
+        return;
+    }
+
+    mCurrentPreset = index;
+    if (index < (int)mFactoryPresets.size()) {
+        request(mFactoryPresets[(size_t)index].values);
+    }
+    else {
+        request(mUserPresets[(size_t)(index - (int)mFactoryPresets.size())].values);
+    }
+}
+
+int PresetBank::addUserPreset(const juce::String& name)
+{
+    mUserPresets.push_back({ name, getCurrentValues() });
+    mCurrentPreset = getNumPresets() - 1;
+    return mCurrentPreset.load();
+}
+
+void PresetBank::rename(int index, const juce::String& name)
+{
+    if (isUserPreset(index)) {
+        mUserPresets[(size_t)(index - (int)mFactoryPresets.size())].name = name;
+    }
+}
+
+void PresetBank::setAudioRunning(bool running)
+{
+    // whatever the audio thread didn't get to is applied here, it isn't running now
+    if (const float* values = takeNewest()) {
+        apply(values);
+    }
+    mAudioRunning = running;
+}
+
+//==============================================================================
+void PresetBank::request(const std::vector<float>& values)
+{
+    jassert((int)values.size() == mParameters.size());
+    if (! mAudioRunning.load()) {
+        apply(values.data());
+        return;
+    }
+
+    // fill this side's slot, then hand it over for whichever slot was there before
+    std::copy(values.begin(), values.end(), mSlotValues.get() + (size_t)mWriteSlot * (size_t)mParameters.size());
+    mWriteSlot = mHandoverSlot.exchange(mWriteSlot | newSetFlag) & ~newSetFlag;
+}
+
+void PresetBank::load(const std::vector<float>& values)
+{
+    apply(values.data());
+
+    // a preset switch still queued for the audio thread mustn't land on top of it
+    if (mAudioRunning.load()) {
+        request(values);
+    }
+}
+
+void PresetBank::applyPending() noexcept
+{
+    // Only the values change here. Notifying the host or the parameter listeners
+    // would call out of the audio thread, so that waits for notifyHost().
+    if (const float* values = takeNewest()) {
+        for (int i = 0; i < mParameters.size(); i++) {
+            mParameters.getUnchecked(i)->setValue(values[i]);
+        }
+        mHostNeedsUpdate = true;
+    }
+}
+
+void PresetBank::notifyHost()
+{
+    if (mHostNeedsUpdate.exchange(false)) {
+        for (auto* parameter : mParameters) {
+            parameter->setValueNotifyingHost(parameter->getValue());
+        }
+    }
+}
+
+const float* PresetBank::takeNewest() noexcept
+{
+    if ((mHandoverSlot.load() & newSetFlag) == 0) {
+        return nullptr;
+    }
+
+    // sets handed over since the last block were replaced by the newest one
+    mReadSlot = mHandoverSlot.exchange(mReadSlot) & ~newSetFlag;
+    return mSlotValues.get() + (size_t)mReadSlot * (size_t)mParameters.size();
+}
+
+void PresetBank::apply(const float* values)
+{
+    for (int i = 0; i < mParameters.size(); i++) {
+        mParameters.getUnchecked(i)->setValueNotifyingHost(values[i]);
+    }
+}
+
+//==============================================================================
+// Binary state, all little endian:
+//   int magic, int version, int current preset
+//   compressed int parameter count, then each parameter's ID
+//   the current plain value of each parameter, as floats
+//   compressed int user preset count, then for each its name and plain values
+void PresetBank::writeState(juce::MemoryBlock& destData) const
+{
+    juce::MemoryOutputStream stream(destData, false);
+    stream.writeInt(stateMagic);
+    stream.writeInt(stateVersion);
+    stream.writeInt(mCurrentPreset.load());
+
+    stream.writeCompressedInt(mParameters.size());
+    for (auto* parameter : mParameters) {
+        stream.writeString(parameter->paramID);
+    }
+
+    const auto writeValues = [&](const std::vector<float>& values) {
+        for (int i = 0; i < mParameters.size(); i++) {
+            stream.writeFloat(mParameters[i]->convertFrom0to1(values[(size_t)i]));
+        }
+    };
+    writeValues(getCurrentValues());
+
+    stream.writeCompressedInt((int)mUserPresets.size());
+    for (const auto& preset : mUserPresets) {
+        stream.writeString(preset.name);
+        writeValues(preset.values);
+    }
+}
+
+bool PresetBank::readState(const void* data, int sizeInBytes)
+{
+    if (data == nullptr || sizeInBytes < 8) {
+        return false;
+    }
+
+    juce::MemoryInputStream stream(data, (size_t)sizeInBytes, false);
+    if (stream.readInt() == stateMagic) {
+        return readBinaryState(stream);
+    }
+
+    // sessions from before the binary state
+    return readXmlState(data, sizeInBytes);
+}
+
+bool PresetBank::readBinaryState(juce::MemoryInputStream& stream)
+{
+    // a newer build may have changed the layout, so its state isn't guessed at
+    const int version = stream.readInt();
+    const int currentPreset = stream.readInt();
+    if (version < 1 || version > stateVersion) {
+        return false;
+    }
+
+    // where each stored parameter goes now, -1 for ones this build doesn't have
+    const int numStored = stream.readCompressedInt();
+    if (numStored < 0 || numStored > maxStoredParameters) {
+        return false;
+    }
+    std::vector<int> mapping((size_t)numStored);
+    for (auto& index : mapping) {
+        auto* parameter = mState.getParameter(stream.readString());
+        index = parameter != nullptr ? parameter->getParameterIndex() : -1;
+    }
+
+    // Parameters the state doesn't know of start from their defaults. A state
+    // cut short is rejected rather than half loaded.
+    const auto readValues = [&](std::vector<float>& values) {
+        if (stream.getNumBytesRemaining() < (juce::int64)numStored * (juce::int64)sizeof(float)) {
+            return false;
+        }
+        values = getDefaults();
+        for (int index : mapping) {
+            const float value = stream.readFloat();
+            if (index >= 0) {
+                values[(size_t)index] = mParameters[index]->convertTo0to1(value);
+            }
+        }
+        return true;
+    };
+
+    std::vector<float> current;
+    if (! readValues(current)) {
+        return false;
+    }
+
+    const int numUserPresets = stream.readCompressedInt();
+    if (numUserPresets < 0 || numUserPresets > maxStoredPresets) {
+        return false;
+    }
+    std::vector<Preset> userPresets((size_t)numUserPresets);
+    for (auto& preset : userPresets) {
+        preset.name = stream.readString();
+        if (! readValues(preset.values)) {
+            return false;
+        }
+    }
+
+    mUserPresets = std::move(userPresets);
+    mCurrentPreset = juce::jlimit(0, getNumPresets() - 1, currentPreset);
+    load(current);
+    return true;
+}
+
+bool PresetBank::readXmlState(const void* data, int sizeInBytes)
+{
+    std::unique_ptr<juce::XmlElement> xml(juce::AudioProcessor::getXmlFromBinary(data, sizeInBytes));
+    if (xml == nullptr || ! xml->hasTagName(mState.state.getType())) {
+        return false;
+    }
+
+    // <Telay><PARAM id="DryWet" value="0.5"/>...</Telay>, with plain values
+    auto values = getDefaults();
+    for (auto* child : xml->getChildIterator()) {
+        auto* parameter = mState.getParameter(child->getStringAttribute("id"));
+        if (parameter != nullptr) {
+            values[(size_t)parameter->getParameterIndex()]
+                = parameter->convertTo0to1((float)child->getDoubleAttribute("value"));
+        }
+    }
+
+    mCurrentPreset = 0;
+    load(values);
+    return true;
+}
@@ -0,0 +1,106 @@
+/*
+  ==============================================================================
+
+    PresetBank.h
+
+    Factory and user presets, and the plugin state they are saved in. The state
+    is a small versioned binary blob of parameter IDs and values, with the old
+    APVTS XML still read for sessions saved before it, and is loaded straight
+    away on the calling thread. Switching preset while audio runs queues a
+    whole set of values that the audio thread applies at the top of its next
+    block, so every parameter changes together and nothing locks or allocates
+    there. The host hears of those from notifyHost() on the message thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+*/
+class PresetBank
+{
+public:
+    static constexpr int stateMagic = 0x59414c54;   // "TLAY"
+    // states from a newer version than this are rejected rather than misread
+    static constexpr int stateVersion = 1;
+
+    explicit PresetBank(juce::AudioProcessorValueTreeState& state);
+
+    // Construction time only. Parameters not listed keep their defaults. Values are plain, not 0..1.
+    void addFactoryPreset(const juce::String& name, std::initializer_list<std::pair<std::string, float>> values);
+
+    //==============================================================================
+    // Message thread. Factory presets come first, then the user's.
+    int getNumPresets() const noexcept { return (int)(mFactoryPresets.size() + mUserPresets.size()); }
+    int getCurrentPreset() const noexcept { return mCurrentPreset.load(); }
+    juce::String getName(int index) const;
+    bool isUserPreset(int index) const noexcept;
+
+    void select(int index);
+    // stores the current values as a new user preset and returns its index
+    int addUserPreset(const juce::String& name);
+    // only user presets can be renamed
+    void rename(int index, const juce::String& name);
+
+    // Call with true from prepareToPlay and false from releaseResources. While
+    // no audio runs, selects apply straight away.
+    void setAudioRunning(bool running);
+
+    // The current values, the selected preset and the user presets
+    void writeState(juce::MemoryBlock& destData) const;
+    // Returns false if the data is neither a binary nor an XML state, or is from
+    // a newer version. A state that loads applies before this returns.
+    bool readState(const void* data, int sizeInBytes);
+
+    // Message thread, regularly. Tells the host and the editor about values the
+    // audio thread switched to since the last call.
+    void notifyHost();
+
+    //==============================================================================
+    // Audio thread, at the top of processBlock before any parameter is read
+    void applyPending() noexcept;
+
+private:
+    // normalised values in the processor's parameter order
+    struct Preset
+    {
+        juce::String name;
+        std::vector<float> values;
+    };
+
+    std::vector<float> getDefaults() const;
+    std::vector<float> getCurrentValues() const;
+    bool readBinaryState(juce::MemoryInputStream& stream);
+    bool readXmlState(const void* data, int sizeInBytes);
+    void request(const std::vector<float>& values);
+    void load(const std::vector<float>& values);
+    void apply(const float* values);
+    const float* takeNewest() noexcept;
+
+    juce::AudioProcessorValueTreeState& mState;
+    juce::Array<juce::RangedAudioParameter*> mParameters;
+
+    std::vector<Preset> mFactoryPresets;
+    std::vector<Preset> mUserPresets;
+    std::atomic<int> mCurrentPreset;
+    std::atomic<bool> mAudioRunning;
+    // set when the audio thread switched values without telling anyone
+    std::atomic<bool> mHostNeedsUpdate;
+
+    // Message thread to audio thread, a triple buffer of value sets so the newest
+    // always wins and neither side waits. Each side owns one slot, the third is
+    // swapped through mHandoverSlot, with newSetFlag set while it holds a set the
+    // audio thread hasn't taken yet.
+    static constexpr int numSlots = 3;
+    static constexpr int newSetFlag = 4;
+    std::atomic<int> mHandoverSlot;
+    int mWriteSlot;
+    int mReadSlot;
+    juce::HeapBlock<float> mSlotValues;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PresetBank)
+};
@@ -0,0 +1,99 @@
+/*
+  ==============================================================================
+
+    ReservedMemory.cpp
+
+  ==============================================================================
+*/
+
+#include "ReservedMemory.h"
+
+#if JUCE_LINUX
+ #include <sys/mman.h>
+ #include <unistd.h>
+#endif
+
+ReservedMemory::ReservedMemory()
+{
+    mData = nullptr;
+    mSize = 0;
+}
+
+ReservedMemory::~ReservedMemory()
+{
+    release();
+}
+
+bool ReservedMemory::isLazy() noexcept
+{
+#if JUCE_LINUX
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool ReservedMemory::reserve(size_t numBytes)
+{
+    release();
+
+#if JUCE_LINUX
+    // anonymous pages are zero and only backed by RAM once written
+    void* data = mmap(nullptr, numBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+#else
+    void* data = std::calloc(numBytes, 1);
+    if (data == nullptr) {
+        return false;
+    }
+#endif
+
+    mData = data;
+    mSize = numBytes;
+    return true;
+}
+
+void ReservedMemory::release()
+{
+    if (mData == nullptr) {
+        return;
+    }
+
+#if JUCE_LINUX
+    munmap(mData, mSize);
+#else
+    std::free(mData);
+#endif
+
+    mData = nullptr;
+    mSize = 0;
+}
+
+bool ReservedMemory::decommit(size_t offset, size_t numBytes)
+{
+    jassert(offset + numBytes <= mSize);
+
+#if JUCE_LINUX
+    char* const start = (char*)mData + offset;
+    char* const end = start + numBytes;
+
+    // only whole pages can be dropped, the ragged ends are zeroed by hand
+    const uintptr_t pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+    char* const firstPage = (char*)(((uintptr_t)start + pageSize - 1) & ~(pageSize - 1));
+    char* const lastPage = (char*)((uintptr_t)end & ~(pageSize - 1));
+
+    if (firstPage >= lastPage) {
+        std::memset(start, 0, numBytes);
+        return true;
+    }
+
+    std::memset(start, 0, (size_t)(firstPage - start));
+    std::memset(lastPage, 0, (size_t)(end - lastPage));
+    return madvise(firstPage, (size_t)(lastPage - firstPage), MADV_DONTNEED) == 0;
+#else
+    juce::ignoreUnused(offset, numBytes);
+    return false;
+#endif
+}
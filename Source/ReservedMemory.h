@@ -0,0 +1,49 @@
+/*
+  ==============================================================================
+
+    ReservedMemory.h
+
+    A zero-filled block of memory that is only paid for once it is used.
+    On Linux the block is reserved address space whose pages are committed
+    on first touch and can be handed back to the OS again. Elsewhere it falls
+    back to a plain zeroed allocation.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+//==============================================================================
+/**
+*/
+class ReservedMemory
+{
+public:
+    ReservedMemory();
+    ~ReservedMemory();
+
+    // True where untouched pages cost no RAM and decommit() works
+    static bool isLazy() noexcept;
+
+    // Frees any previous block and reserves numBytes of zeroed memory.
+    // Returns false if the reservation failed.
+    bool reserve(size_t numBytes);
+    void release();
+
+    // Returns the pages in the range to the OS so they read as zero again,
+    // zeroing the partial pages at either end. Makes a system call, so it
+    // doesn't belong on the audio thread. Returns false, doing nothing, if
+    // the platform can't do it.
+    bool decommit(size_t offset, size_t numBytes);
+
+    void* getData() const noexcept { return mData; }
+    size_t getSize() const noexcept { return mSize; }
+
+private:
+    void* mData;
+    size_t mSize;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ReservedMemory)
+};
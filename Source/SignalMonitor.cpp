@@ -0,0 +1,151 @@
+/*
+  ==============================================================================
+
+    SignalMonitor.cpp
+
+  ==============================================================================
+*/
+
+#include "SignalMonitor.h"
+
+SignalMonitor::SignalMonitor()
+    : mFrameFifo(frameFifoSize),
+      mScopeFifo(scopeFifoSize)
+{
+    mNumViewers = 0;
+    mActive = false;
+    mFeedbackPeak = 0.0f;
+    mFeedbackSquares = 0.0;
+    mFeedbackCount = 0;
+    mSamplesPerColumn = 1;
+    mColumnCount = 0;
+    mColumn = { 0.0f, 0.0f };
+}
+
+SignalMonitor::Level SignalMonitor::measure(const juce::AudioBuffer<float>& buffer) noexcept
+{
+    // the loudest channel's peak, and the RMS over every channel
+    Level level = { 0.0f, 0.0f };
+    double squares = 0.0;
+    const int numSamples = buffer.getNumSamples();
+
+    for (int channel = 0; channel < buffer.getNumChannels(); channel++) {
+        const float* samples = buffer.getReadPointer(channel);
+        const auto range = juce::FloatVectorOperations::findMinAndMax(samples, numSamples);
+        level.peak = juce::jmax(level.peak, -range.getStart(), range.getEnd());
+
+        const float rms = buffer.getRMSLevel(channel, 0, numSamples);
+        squares += (double)rms * rms;
+    }
+
+    if (buffer.getNumChannels() > 0) {
+        level.rms = (float)std::sqrt(squares / buffer.getNumChannels());
+    }
+    return level;
+}
+
+SignalMonitor::ScopedBlock::ScopedBlock(SignalMonitor& monitor, juce::AudioBuffer<float>& buffer) noexcept
+    : mMonitor(monitor), mBuffer(buffer)
+{
+    mMonitor.mActive = mMonitor.mNumViewers.load() > 0 && buffer.getNumSamples() > 0;
+    mInput = mMonitor.mActive ? measure(buffer) : Level { 0.0f, 0.0f };
+}
+
+SignalMonitor::ScopedBlock::~ScopedBlock() noexcept
+{
+    if (! mMonitor.mActive) {
+        return;
+    }
+
+    Frame frame;
+    frame.input = mInput;
+    frame.output = measure(mBuffer);
+    frame.feedback.peak = mMonitor.mFeedbackPeak;
+    frame.feedback.rms = mMonitor.mFeedbackCount > 0
+        ? (float)std::sqrt(mMonitor.mFeedbackSquares / mMonitor.mFeedbackCount) : 0.0f;
+    frame.lfoPhase = lfoPhase;
+    frame.lfoValue = lfoValue;
+    frame.lfoActive = lfoActive;
+
+    mMonitor.mFeedbackPeak = 0.0f;
+    mMonitor.mFeedbackSquares = 0.0;
+    mMonitor.mFeedbackCount = 0;
+
+    // an editor that falls behind just misses frames
+    const auto scope = mMonitor.mFrameFifo.write(1);
+    if (scope.blockSize1 > 0) {
+        mMonitor.mFrames[scope.startIndex1] = frame;
+    }
+    else if (scope.blockSize2 > 0) {
+        mMonitor.mFrames[scope.startIndex2] = frame;
+    }
+}
+
+void SignalMonitor::addFeedback(const float* samples, int numSamples, float gain) noexcept
+{
+    if (! mActive) {
+        return;
+    }
+
+    float peak = 0.0f;
+    double squares = 0.0;
+    for (int i = 0; i < numSamples; i++) {
+        const float sample = samples[i] * gain;
+        peak = juce::jmax(peak, std::abs(sample));
+        squares += (double)sample * sample;
+    }
+
+    mFeedbackPeak = juce::jmax(mFeedbackPeak, peak);
+    mFeedbackSquares += squares;
+    mFeedbackCount += numSamples;
+}
+
+void SignalMonitor::setScopeSweep(double samplesPerSweep) noexcept
+{
+    mSamplesPerColumn = juce::jmax(1, juce::roundToInt(samplesPerSweep / scopeColumns));
+}
+
+void SignalMonitor::addScope(const float* samples, int numSamples) noexcept
+{
+    if (! mActive) {
+        return;
+    }
+
+    for (int i = 0; i < numSamples; i++) {
+        const float sample = samples != nullptr ? samples[i] : 0.0f;
+        if (mColumnCount == 0) {
+            mColumn = { sample, sample };
+        }
+        else {
+            mColumn.min = juce::jmin(mColumn.min, sample);
+            mColumn.max = juce::jmax(mColumn.max, sample);
+        }
+
+        if (++mColumnCount >= mSamplesPerColumn) {
+            const auto scope = mScopeFifo.write(1);
+            if (scope.blockSize1 > 0) {
+                mScope[scope.startIndex1] = mColumn;
+            }
+            else if (scope.blockSize2 > 0) {
+                mScope[scope.startIndex2] = mColumn;
+            }
+            mColumnCount = 0;
+        }
+    }
+}
+
+int SignalMonitor::readFrames(Frame* destination, int maxItems) noexcept
+{
+    const auto scope = mFrameFifo.read(juce::jmin(maxItems, mFrameFifo.getNumReady()));
+    int count = 0;
+    scope.forEach([&](int index) { destination[count++] = mFrames[index]; });
+    return count;
+}
+
+int SignalMonitor::readScope(ScopeColumn* destination, int maxItems) noexcept
+{
+    const auto scope = mScopeFifo.read(juce::jmin(maxItems, mScopeFifo.getNumReady()));
+    int count = 0;
+    scope.forEach([&](int index) { destination[count++] = mScope[index]; });
+    return count;
+}
@@ -0,0 +1,118 @@
+/*
+  ==============================================================================
+
+    SignalMonitor.h
+
+    Level, LFO and delay line summaries for the editor. The audio thread boils
+    each block down to a few peak/RMS figures and a run of min/max scope
+    columns and hands them over through lock-free FIFOs. With no editor open
+    it skips the work entirely.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+*/
+class SignalMonitor
+{
+public:
+    static constexpr int frameFifoSize = 512;
+    static constexpr int scopeFifoSize = 2048;
+
+    // the scope shows one sweep of the delay line in this many columns
+    static constexpr int scopeColumns = 256;
+
+    struct Level
+    {
+        float peak;
+        float rms;
+    };
+
+    // one per block
+    struct Frame
+    {
+        Level input;
+        Level output;
+        Level feedback;
+        float lfoPhase;     // 0..1
+        float lfoValue;     // -1..1
+        bool lfoActive;     // the effect type is modulated
+    };
+
+    // the lowest and highest sample written into the first ring over one column
+    struct ScopeColumn
+    {
+        float min;
+        float max;
+    };
+
+    SignalMonitor();
+
+    // Editors register while they are open, message thread only
+    void addViewer() noexcept { ++mNumViewers; }
+    void removeViewer() noexcept { --mNumViewers; }
+
+    //==============================================================================
+    /**
+        Put one of these at the top of processBlock. It measures the input
+        straight away and the output when it goes out of scope. The LFO fields
+        are filled in by processBlock.
+    */
+    class ScopedBlock
+    {
+    public:
+        ScopedBlock(SignalMonitor& monitor, juce::AudioBuffer<float>& buffer) noexcept;
+        ~ScopedBlock() noexcept;
+
+        float lfoPhase = 0.0f;
+        float lfoValue = 0.0f;
+        bool lfoActive = false;
+
+    private:
+        SignalMonitor& mMonitor;
+        juce::AudioBuffer<float>& mBuffer;
+        Level mInput;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedBlock)
+    };
+
+    // Audio thread, inside a ScopedBlock. Each is a no-op when nobody is watching.
+    // The feedback level is of samples * gain, summed over every call in the block.
+    void addFeedback(const float* samples, int numSamples, float gain) noexcept;
+
+    // Samples written into the first ring, or null for silence. One sweep of the
+    // scope covers samplesPerSweep of them.
+    void addScope(const float* samples, int numSamples) noexcept;
+    void setScopeSweep(double samplesPerSweep) noexcept;
+
+    //==============================================================================
+    // Message thread, copies out up to maxItems of what has come in and returns how many
+    int readFrames(Frame* destination, int maxItems) noexcept;
+    int readScope(ScopeColumn* destination, int maxItems) noexcept;
+
+private:
+    static Level measure(const juce::AudioBuffer<float>& buffer) noexcept;
+
+    std::atomic<int> mNumViewers;
+
+    // audio thread state, mActive is latched at the start of every block
+    bool mActive;
+    float mFeedbackPeak;
+    double mFeedbackSquares;
+    int mFeedbackCount;
+    int mSamplesPerColumn;
+    int mColumnCount;
+    ScopeColumn mColumn;
+
+    juce::AbstractFifo mFrameFifo;
+    Frame mFrames[frameFifoSize];
+    juce::AbstractFifo mScopeFifo;
+    ScopeColumn mScope[scopeFifoSize];
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SignalMonitor)
+};
@@ -0,0 +1,207 @@
+/*
+  ==============================================================================
+
+    SignalView.cpp
+
+  ==============================================================================
+*/
+
+#include "SignalView.h"
+
+// meters read from -60 dBFS to 0 dBFS and fall back at 24 dB a second
+static const float meterFloor = -60.0f;
+static const float meterFallPerFrame = juce::Decibels::decibelsToGain(-24.0f / SignalView::frameRate);
+
+static const int meterWidth = 18;
+static const int labelHeight = 14;
+
+SignalView::SignalView(SignalMonitor& monitor)
+    : mMonitor(monitor)
+{
+    for (auto& meter : mMeters) {
+        meter = { 0.0f, 0.0f, 0, 0 };
+    }
+    mLfoPhase = 0.0f;
+    mLfoActive = false;
+
+    // a tick's worth of frames at the smallest blocks and more than a sweep of columns
+    mFrames.resize(SignalMonitor::frameFifoSize);
+    mColumns.resize(SignalMonitor::scopeFifoSize);
+
+    setOpaque(true);
+    mMonitor.addViewer();
+    startTimerHz(frameRate);
+}
+
+SignalView::~SignalView()
+{
+    stopTimer();
+    mMonitor.removeViewer();
+}
+
+void SignalView::resized()
+{
+    auto area = getLocalBounds().reduced(4);
+    mMeterArea = area.removeFromLeft(numMeters * (meterWidth + 8));
+    area.removeFromLeft(8);
+    mLfoArea = area.removeFromLeft(area.getWidth() / 3).withTrimmedTop(labelHeight);
+    area.removeFromLeft(8);
+    mScopeArea = area.withTrimmedTop(labelHeight);
+
+    mLfoImage = juce::Image(juce::Image::ARGB, juce::jmax(1, mLfoArea.getWidth()), juce::jmax(1, mLfoArea.getHeight()), true);
+    mScopeImage = juce::Image(juce::Image::ARGB, SignalMonitor::scopeColumns, juce::jmax(1, mScopeArea.getHeight()), true);
+    drawBackground();
+}
+
+void SignalView::drawBackground()
+{
+    mBackground = juce::Image(juce::Image::RGB, juce::jmax(1, getWidth()), juce::jmax(1, getHeight()), false);
+    juce::Graphics g(mBackground);
+    g.fillAll(getLookAndFeel().findColour(juce::ResizableWindow::backgroundColourId).darker(0.2f));
+
+    g.setFont(11.0f);
+    g.setColour(juce::Colours::white.withAlpha(0.7f));
+    const char* meterNames[numMeters] = { "In", "Out", "Fb" };
+    for (int meter = 0; meter < numMeters; meter++) {
+        const auto bounds = getMeterBounds(meter);
+        g.drawText(meterNames[meter], bounds.getX() - 4, bounds.getBottom() + 1, meterWidth + 8, labelHeight - 2,
+            juce::Justification::centred);
+    }
+    g.drawText("LFO", mLfoArea.getX(), mLfoArea.getY() - labelHeight, mLfoArea.getWidth(), labelHeight - 2,
+        juce::Justification::centredLeft);
+    g.drawText("Delay line", mScopeArea.getX(), mScopeArea.getY() - labelHeight, mScopeArea.getWidth(), labelHeight - 2,
+        juce::Justification::centredLeft);
+
+    g.setColour(juce::Colours::black.withAlpha(0.5f));
+    for (int meter = 0; meter < numMeters; meter++) {
+        g.fillRect(getMeterBounds(meter));
+    }
+    g.fillRect(mLfoArea);
+    g.fillRect(mScopeArea);
+
+    // centre lines for the traces
+    g.setColour(juce::Colours::white.withAlpha(0.15f));
+    g.drawHorizontalLine(mLfoArea.getCentreY(), (float)mLfoArea.getX(), (float)mLfoArea.getRight());
+    g.drawHorizontalLine(mScopeArea.getCentreY(), (float)mScopeArea.getX(), (float)mScopeArea.getRight());
+}
+
+juce::Rectangle<int> SignalView::getMeterBounds(int meter) const
+{
+    return { mMeterArea.getX() + meter * (meterWidth + 8) + 4, mMeterArea.getY(),
+        meterWidth, mMeterArea.getHeight() - labelHeight };
+}
+
+float SignalView::toMeterPosition(float gain)
+{
+    const float decibels = juce::Decibels::gainToDecibels(gain, meterFloor);
+    return juce::jlimit(0.0f, 1.0f, (decibels - meterFloor) / -meterFloor);
+}
+
+void SignalView::scrollImage(juce::Image& image, int numColumns)
+{
+    const int width = image.getWidth();
+    numColumns = juce::jmin(numColumns, width);
+    if (numColumns < width) {
+        image.moveImageSection(0, 0, numColumns, 0, width - numColumns, image.getHeight());
+    }
+    image.clear({ width - numColumns, 0, numColumns, image.getHeight() });
+}
+
+void SignalView::timerCallback()
+{
+    // Meters: the loudest of everything since the last tick, or the old reading falling away
+    const int numFrames = mMonitor.readFrames(mFrames.data(), (int)mFrames.size());
+    for (int meter = 0; meter < numMeters; meter++) {
+        MeterState& state = mMeters[meter];
+        state.peak *= meterFallPerFrame;
+        state.rms *= meterFallPerFrame;
+
+        for (int i = 0; i < numFrames; i++) {
+            const auto& frame = mFrames[(size_t)i];
+            const SignalMonitor::Level& level = meter == meterInput ? frame.input
+                : meter == meterOutput ? frame.output : frame.feedback;
+            state.peak = juce::jmax(state.peak, level.peak);
+            state.rms = juce::jmax(state.rms, level.rms);
+        }
+
+        // only meters that moved by a pixel get repainted
+        const auto bounds = getMeterBounds(meter);
+        const int peak = juce::roundToInt(toMeterPosition(state.peak) * bounds.getHeight());
+        const int rms = juce::roundToInt(toMeterPosition(state.rms) * bounds.getHeight());
+        if (peak != state.paintedPeak || rms != state.paintedRms) {
+            state.paintedPeak = peak;
+            state.paintedRms = rms;
+            repaint(bounds);
+        }
+    }
+
+    // LFO: one column per tick, from the newest frame
+    if (numFrames > 0) {
+        const auto& frame = mFrames[(size_t)(numFrames - 1)];
+        mLfoActive = frame.lfoActive;
+        mLfoPhase = frame.lfoPhase;
+
+        scrollImage(mLfoImage, 1);
+        if (mLfoActive) {
+            juce::Graphics g(mLfoImage);
+            g.setColour(juce::Colours::orange);
+            const float y = (0.5f - 0.45f * frame.lfoValue) * mLfoImage.getHeight();
+            g.fillRect((float)mLfoImage.getWidth() - 1, y - 1, 1.0f, 2.0f);
+        }
+        repaint(mLfoArea);
+    }
+
+    // Scope: the new columns scroll in from the right
+    const int numColumns = mMonitor.readScope(mColumns.data(), (int)mColumns.size());
+    if (numColumns > 0) {
+        const int drawn = juce::jmin(numColumns, mScopeImage.getWidth());
+        scrollImage(mScopeImage, drawn);
+
+        juce::Graphics g(mScopeImage);
+        g.setColour(juce::Colours::lightskyblue);
+        const float halfHeight = mScopeImage.getHeight() * 0.5f;
+        const int first = numColumns - drawn;
+        for (int i = 0; i < drawn; i++) {
+            const auto& column = mColumns[(size_t)(first + i)];
+            const float top = halfHeight * (1 - juce::jlimit(-1.0f, 1.0f, column.max));
+            const float bottom = halfHeight * (1 - juce::jlimit(-1.0f, 1.0f, column.min));
+            g.fillRect((float)(mScopeImage.getWidth() - drawn + i), top, 1.0f, juce::jmax(1.0f, bottom - top));
+        }
+        repaint(mScopeArea);
+    }
+}
+
+void SignalView::paint(juce::Graphics& g)
+{
+    // the background covers everything, the rest only the parts that have content
+    g.drawImageAt(mBackground, 0, 0);
+
+    for (int meter = 0; meter < numMeters; meter++) {
+        const auto bounds = getMeterBounds(meter);
+        if (! g.clipRegionIntersects(bounds)) {
+            continue;
+        }
+
+        const MeterState& state = mMeters[meter];
+        g.setColour(juce::Colours::limegreen.withAlpha(0.8f));
+        g.fillRect(bounds.withTop(bounds.getBottom() - state.paintedRms));
+        g.setColour(state.peak >= 1.0f ? juce::Colours::red : juce::Colours::yellow);
+        g.fillRect(bounds.getX(), bounds.getBottom() - state.paintedPeak, bounds.getWidth(), 2);
+    }
+
+    if (g.clipRegionIntersects(mLfoArea)) {
+        g.drawImageAt(mLfoImage, mLfoArea.getX(), mLfoArea.getY());
+
+        // where the LFO is in its cycle, a dot along the bottom
+        if (mLfoActive) {
+            g.setColour(juce::Colours::orange);
+            g.fillEllipse((float)mLfoArea.getX() + mLfoPhase * (mLfoArea.getWidth() - 6), (float)mLfoArea.getBottom() - 7,
+                6.0f, 6.0f);
+        }
+    }
+
+    if (g.clipRegionIntersects(mScopeArea)) {
+        g.setImageResamplingQuality(juce::Graphics::lowResamplingQuality);
+        g.drawImage(mScopeImage, mScopeArea.toFloat());
+    }
+}
@@ -0,0 +1,77 @@
+/*
+  ==============================================================================
+
+    SignalView.h
+
+    Input, output and feedback meters, an LFO trace and a scope of the delay
+    line, fed from the processor's SignalMonitor. It polls at a fixed frame
+    rate, draws the traces into cached images a column at a time and only
+    repaints the parts that changed.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SignalMonitor.h"
+
+//==============================================================================
+/**
+*/
+class SignalView : public juce::Component, private juce::Timer
+{
+public:
+    static constexpr int frameRate = 30;
+
+    explicit SignalView(SignalMonitor& monitor);
+    ~SignalView() override;
+
+    void paint(juce::Graphics&) override;
+    void resized() override;
+
+private:
+    enum Meter
+    {
+        meterInput = 0,
+        meterOutput,
+        meterFeedback,
+        numMeters
+    };
+
+    struct MeterState
+    {
+        float peak;
+        float rms;
+        // the height in pixels last painted, to tell if a repaint is needed
+        int paintedPeak;
+        int paintedRms;
+    };
+
+    void timerCallback() override;
+    void drawBackground();
+    void scrollImage(juce::Image& image, int numColumns);
+    juce::Rectangle<int> getMeterBounds(int meter) const;
+    static float toMeterPosition(float gain);
+
+    SignalMonitor& mMonitor;
+
+    MeterState mMeters[numMeters];
+    float mLfoPhase;
+    bool mLfoActive;
+
+    juce::Rectangle<int> mMeterArea;
+    juce::Rectangle<int> mLfoArea;
+    juce::Rectangle<int> mScopeArea;
+
+    // the labels and frames, and the two traces, only redrawn where they change
+    juce::Image mBackground;
+    juce::Image mLfoImage;
+    juce::Image mScopeImage;
+
+    // scratch for draining the monitor, sized once
+    std::vector<SignalMonitor::Frame> mFrames;
+    std::vector<SignalMonitor::ScopeColumn> mColumns;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SignalView)
+};
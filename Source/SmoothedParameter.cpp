@@ -0,0 +1,42 @@
+/*
+  ==============================================================================
+
+    SmoothedParameter.cpp
+
+  ==============================================================================
+*/
+
+#include "SmoothedParameter.h"
+
+SmoothedParameter::SmoothedParameter()
+{
+    mMaximumBlockSize = 0;
+}
+
+void SmoothedParameter::prepare(double sampleRate, int maximumBlockSize, double rampLengthSeconds)
+{
+    const float current = mSmoothed.getTargetValue();
+    mSmoothed.reset(sampleRate, rampLengthSeconds);
+    mSmoothed.setCurrentAndTargetValue(current);
+
+    // the ramp only ever grows, a smaller block size keeps the old one
+    if (maximumBlockSize > mMaximumBlockSize) {
+        mRamp.allocate((size_t)maximumBlockSize, true);
+        mMaximumBlockSize = maximumBlockSize;
+    }
+}
+
+const float* SmoothedParameter::process(int numSamples) noexcept
+{
+    if (! mSmoothed.isSmoothing()) {
+        return nullptr;
+    }
+
+    jassert(numSamples <= mMaximumBlockSize);
+
+    float* ramp = mRamp.get();
+    for (int i = 0; i < numSamples; i++) {
+        ramp[i] = mSmoothed.getNextValue();
+    }
+    return ramp;
+}
@@ -0,0 +1,48 @@
+/*
+  ==============================================================================
+
+    SmoothedParameter.h
+
+    Block-based parameter smoothing. The audio thread hands over one snapshot
+    of the parameter per block, and process() either reports that the value
+    is constant or fills a per-sample ramp the caller can run vector code over.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+
+//==============================================================================
+/**
+*/
+class SmoothedParameter
+{
+public:
+    SmoothedParameter();
+
+    // Allocates the ramp buffer if it has to grow, call from prepareToPlay
+    void prepare(double sampleRate, int maximumBlockSize, double rampLengthSeconds = 0.05);
+
+    // Jump straight to a value, no ramp
+    void reset(float value) noexcept { mSmoothed.setCurrentAndTargetValue(value); }
+
+    // The once-per-block snapshot of the parameter
+    void setTarget(float value) noexcept { mSmoothed.setTargetValue(value); }
+
+    // Advances numSamples (at most the prepared block size). Returns nullptr when
+    // the value doesn't change over the run, in which case use getCurrentValue(),
+    // otherwise a ramp of numSamples values.
+    const float* process(int numSamples) noexcept;
+
+    float getCurrentValue() const noexcept { return mSmoothed.getCurrentValue(); }
+    bool isSmoothing() const noexcept { return mSmoothed.isSmoothing(); }
+
+private:
+    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> mSmoothed;
+    juce::HeapBlock<float> mRamp;
+    int mMaximumBlockSize;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SmoothedParameter)
+};